@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Non-owning view of a contiguous run of values allocated in an Arena
+template <typename T>
+struct ArenaSpan {
+    T* items = nullptr;
+    uint32_t count = 0;
+
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t index) const { return items[index]; }
+};
+
+// Bump allocator for AST nodes. Objects are packed into large blocks and all released together when the arena is
+// destroyed; destructors are only recorded (and run) for types that actually need them.
+class Arena {
+private:
+    static constexpr size_t block_size = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t used = 0;
+    size_t objects = 0;
+    vector<pair<void*, void (*)(void*)>> destructors;
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) { it->second(it->first); }
+    }
+
+    void* allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        if (cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            size_t capacity = max(block_size, size + alignment);
+            blocks.emplace_back(new char[capacity]);
+            cursor = blocks.back().get();
+            limit = cursor + capacity;
+            aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        }
+        cursor = reinterpret_cast<char*>(aligned + size);
+        used += size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+        ++objects;
+        if constexpr (!is_trivially_destructible_v<T>) {
+            destructors.emplace_back(object, [](void* p) { static_cast<T*>(p)->~T(); });
+        }
+        return object;
+    }
+
+    template <typename T>
+    ArenaSpan<T> copy(const vector<T>& values) {
+        static_assert(is_trivially_copyable_v<T>, "ArenaSpan only holds trivially copyable values");
+        ArenaSpan<T> span;
+        span.count = values.size();
+        if (!values.empty()) {
+            span.items = static_cast<T*>(allocate(sizeof(T) * values.size(), alignof(T)));
+            memcpy(span.items, values.data(), sizeof(T) * values.size());
+        }
+        return span;
+    }
+
+    size_t bytes_used() const { return used; }
+    // Objects built with make; for the parser's arenas, AST nodes
+    size_t objects_made() const { return objects; }
+};
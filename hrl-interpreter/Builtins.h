@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Interner.h"
+#include "Value.h"
+using namespace std;
+
+template <typename T>
+string join(const vector<T>& vec, const string& delimiter) {
+    stringstream ss;
+    for (size_t i = 0; i < vec.size(); ++i) {
+        if (i != 0) ss << delimiter;
+        ss << vec[i];
+    }
+    return ss.str();
+}
+
+// A native function receives its already evaluated arguments, in call order
+using NativeFunction = Value (*)(const Value* args, size_t count);
+
+struct Builtin {
+    SymbolId name;
+    uint32_t index;
+    NativeFunction function;
+    uint32_t min_args;
+    uint32_t max_args;
+    // Rough cost of one call, used by the cost model to decide what is worth running in parallel
+    uint32_t cost;
+};
+
+namespace natives {
+
+inline Value print(const Value* args, size_t count) {
+    const Value& value = args[0];
+    switch (value.type()) {
+        case ValueType::Null: cout << "NULL" << endl; break;
+        case ValueType::Int: cout << value.int_unchecked() << endl; break;
+        case ValueType::String: cout << value.as_string() << endl; break;
+        case ValueType::Double: cout << value.double_unchecked() << endl; break;
+        case ValueType::Bool: cout << value.bool_unchecked() << endl; break;
+        default: break;
+    }
+    return value;
+}
+
+inline Value read(const Value* args, size_t count) {
+    int value;
+    cin >> value;
+    return Value(value);
+}
+
+inline Value callprogram(const Value* args, size_t count) {
+    const string& program_name = args[0].as_string();
+    vector<string> args_strings;
+    for (size_t i = 1; i < count; ++i) { args_strings.push_back(args[i].as_string()); }
+    if (program_name.find(".py") != string::npos) {
+        string command = "python " + program_name + " " + join(args_strings, " ");
+        return Value(system(command.c_str()));
+    }
+    else if (program_name.find(".lua") != string::npos) {
+        string command = "lua " + program_name + " " + join(args_strings, " ");
+        return Value(system(command.c_str()));
+    }
+    else {
+        string command = "./" + program_name + " " + join(args_strings, " ");
+        return Value(system(command.c_str()));
+    }
+}
+
+}
+
+// Registry of the native functions HRL code can call. The parser binds every call to a registered name straight to
+// its entry, so natives have to be added before the script is parsed. Entries never move once added.
+class Builtins {
+private:
+    deque<Builtin> entries;
+    unordered_map<SymbolId, uint32_t> by_name;
+
+    Builtins() {
+        add("print", natives::print, 1, 1);
+        add("read", natives::read, 0, 0);
+        add("callprogram", natives::callprogram, 1, variadic, 100000);
+    }
+
+public:
+    static constexpr uint32_t variadic = UINT32_MAX;
+
+    static Builtins& global() {
+        static Builtins builtins;
+        return builtins;
+    }
+
+    const Builtin& add(string_view name, NativeFunction function, uint32_t min_args, uint32_t max_args, uint32_t cost = 1) {
+        SymbolId id = intern(name);
+        if (by_name.count(id)) { throw invalid_argument("Builtin already registered: " + string(name)); }
+        uint32_t index = entries.size();
+        entries.push_back({ id, index, function, min_args, max_args, cost });
+        by_name.emplace(id, index);
+        return entries.back();
+    }
+
+    const Builtin* find(SymbolId name) const {
+        auto it = by_name.find(name);
+        return it == by_name.end() ? nullptr : &entries[it->second];
+    }
+
+    const Builtin& at(uint32_t index) const { return entries[index]; }
+};
@@ -0,0 +1,234 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Register-based bytecode. Every instruction has up to four operands; registers are indexes into the frame of
+// the chunk being executed, constants and nodes are indexes into the chunk's side tables.
+#define HRL_OPCODES(X)                                                                                         \
+    X(LOADK)      /* R[a] = constants[b] */                                                                    \
+    X(LOADVAR)    /* R[a] = frame slot b (variable c) */                                                       \
+    X(STOREVAR)   /* frame slot a (variable c) = R[b] */                                                       \
+    X(CHECK)      /* fit R[a] to ValueType b (variable c) with ops::conform, unless null */                    \
+    X(BINOP)      /* R[a] = R[b] <BinOp d> R[c] */                                                             \
+    X(BINOPI)     /* R[a] = R[b] <BinOp d> R[c], both proven to be ints; never Concat */                       \
+    X(BINOPD)     /* R[a] = R[b] <BinOp d> R[c] in doubles, both proven numbers, one a double; never Concat */ \
+    X(JMP)        /* ip = a */                                                                                 \
+    X(JMPF)       /* if !R[a] then ip = b */                                                                   \
+    X(CALL)       /* R[a] = function of FuncCallNode nodes[b] called with R[c] .. R[c + d - 1] */              \
+    X(TAILCALL)   /* return the call of FuncCallNode nodes[b] with R[c] .. R[c + d - 1] on this frame */       \
+    X(NATIVE)     /* R[a] = builtin b called with R[c] .. R[c + d - 1] */                                      \
+    X(EVAL)       /* R[a] = nodes[b] evaluated by the tree-walker */                                           \
+    X(RET)        /* return R[a] */                                                                            \
+    X(LOOPRET)    /* return from the enclosing function with R[a], leaving a compiled loop */                  \
+    X(RETNULL)    /* return null */
+
+enum class OpCode : uint8_t {
+#define HRL_OPCODE_ENUM(name) name,
+    HRL_OPCODES(HRL_OPCODE_ENUM)
+#undef HRL_OPCODE_ENUM
+};
+
+struct Instr {
+    OpCode op;
+    int32_t a = 0, b = 0, c = 0, d = 0;
+};
+
+struct Chunk {
+    vector<Instr> code;
+    vector<EvalResult> constants;
+    vector<NodePtr> nodes;
+    int register_count = 0;
+};
+
+// Compiles a block (a function body, or the setup/main block) into a Chunk. Statements and expressions that
+// have no dedicated instruction are emitted as EVAL, which hands the node back to the tree-walker.
+class BytecodeCompiler {
+private:
+    struct Loop {
+        size_t start;
+        vector<size_t> breaks;
+    };
+
+    Chunk& chunk;
+    int next_register = 0;
+    vector<Loop> loops;
+    // Set while compiling a single loop, whose return statements leave the function it sits in rather than the chunk
+    bool loop_fragment = false;
+
+    int allocate() {
+        int reg = next_register++;
+        chunk.register_count = max(chunk.register_count, next_register);
+        return reg;
+    }
+
+    size_t emit(OpCode op, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0) {
+        chunk.code.push_back({ op, a, b, c, d });
+        return chunk.code.size() - 1;
+    }
+
+    int32_t constant(EvalResult value) {
+        chunk.constants.push_back(move(value));
+        return chunk.constants.size() - 1;
+    }
+
+    int32_t node(NodePtr node) {
+        chunk.nodes.push_back(node);
+        return chunk.nodes.size() - 1;
+    }
+
+    void patch(size_t jump, size_t target) {
+        if (chunk.code[jump].op == OpCode::JMP) { chunk.code[jump].a = target; }
+        else { chunk.code[jump].b = target; }
+    }
+
+    void compile_statement(NodePtr statement) {
+        int mark = next_register;
+        switch (statement->kind) {
+            case NodeKind::NoOp:
+                break;
+            case NodeKind::Block:
+                for (NodePtr child : static_cast<BlockNode*>(statement)->statements) { compile_statement(child); }
+                break;
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(statement);
+                int value = allocate();
+                if (declare->expression) { compile_expression(declare->expression, value); }
+                else { emit(OpCode::LOADK, value, constant(ops::zero(declare->declared))); }
+                if (declare->checked != ValueType::Null) { emit(OpCode::CHECK, value, static_cast<int32_t>(declare->checked), declare->identifier); }
+                emit(OpCode::STOREVAR, declare->slot, value, declare->identifier);
+                break;
+            }
+            case NodeKind::Assignment: {
+                auto assignment = static_cast<AssignmentNode*>(statement);
+                int value = allocate();
+                compile_expression(assignment->expression, value);
+                if (assignment->checked != ValueType::Null) { emit(OpCode::CHECK, value, static_cast<int32_t>(assignment->checked), assignment->identifier); }
+                emit(OpCode::STOREVAR, assignment->slot, value, assignment->identifier);
+                break;
+            }
+            case NodeKind::While: {
+                auto loop = static_cast<WhileNode*>(statement);
+                loops.push_back({ chunk.code.size(), {} });
+                int condition = allocate();
+                compile_expression(loop->condition, condition);
+                size_t exit = emit(OpCode::JMPF, condition);
+                next_register = condition;
+                compile_statement(loop->block);
+                emit(OpCode::JMP, loops.back().start);
+                patch(exit, chunk.code.size());
+                for (size_t jump : loops.back().breaks) { patch(jump, chunk.code.size()); }
+                loops.pop_back();
+                break;
+            }
+            case NodeKind::If: {
+                auto branch = static_cast<IfNode*>(statement);
+                int condition = allocate();
+                compile_expression(branch->condition, condition);
+                size_t to_else = emit(OpCode::JMPF, condition);
+                next_register = condition;
+                compile_statement(branch->block);
+                size_t to_end = emit(OpCode::JMP);
+                patch(to_else, chunk.code.size());
+                compile_statement(branch->else_block);
+                patch(to_end, chunk.code.size());
+                break;
+            }
+            case NodeKind::Return: {
+                auto ret = static_cast<ReturnNode*>(statement);
+                if (ret->tail_call) {
+                    auto call = static_cast<FuncCallNode*>(ret->return_node);
+                    int base = next_register;
+                    for (size_t i = 0; i < call->args.size(); ++i) { allocate(); }
+                    for (size_t i = 0; i < call->args.size(); ++i) { compile_expression(call->args[i], base + i); }
+                    emit(OpCode::TAILCALL, 0, node(call), base, call->args.size());
+                    break;
+                }
+                int value = allocate();
+                compile_expression(ret->return_node, value);
+                emit(loop_fragment ? OpCode::LOOPRET : OpCode::RET, value);
+                break;
+            }
+            case NodeKind::Break:
+                // Outside a loop, break and continue end the enclosing chunk just as they end the body in the tree-walker
+                if (loops.empty()) { emit(OpCode::RETNULL); }
+                else { loops.back().breaks.push_back(emit(OpCode::JMP)); }
+                break;
+            case NodeKind::Continue:
+                if (loops.empty()) { emit(OpCode::RETNULL); }
+                else { emit(OpCode::JMP, loops.back().start); }
+                break;
+            default:
+                compile_expression(statement, allocate());
+                break;
+        }
+        next_register = mark;
+    }
+
+    void compile_expression(NodePtr expression, int target) {
+        int mark = next_register;
+        switch (expression->kind) {
+            case NodeKind::IntVal:
+                emit(OpCode::LOADK, target, constant(EvalResult(static_cast<IntValNode*>(expression)->value)));
+                break;
+            case NodeKind::DoubleVal:
+                emit(OpCode::LOADK, target, constant(EvalResult(static_cast<DoubleValNode*>(expression)->value)));
+                break;
+            case NodeKind::StringVal:
+                emit(OpCode::LOADK, target, constant(EvalResult(static_cast<StringValNode*>(expression)->value)));
+                break;
+            case NodeKind::Var:
+                emit(OpCode::LOADVAR, target, static_cast<VarNode*>(expression)->slot, static_cast<VarNode*>(expression)->identifier);
+                break;
+            case NodeKind::BinOp: {
+                auto binop = static_cast<BinOpNode*>(expression);
+                int left = allocate();
+                int right = allocate();
+                compile_expression(binop->left, left);
+                compile_expression(binop->right, right);
+                OpCode op = OpCode::BINOP;
+                if (binop->op != BinOp::Concat && binop->operands == ValueType::Int) { op = OpCode::BINOPI; }
+                if (binop->op != BinOp::Concat && binop->operands == ValueType::Double) { op = OpCode::BINOPD; }
+                emit(op, target, left, right, static_cast<int32_t>(binop->op));
+                break;
+            }
+            case NodeKind::FuncCall: {
+                auto call = static_cast<FuncCallNode*>(expression);
+                int base = next_register;
+                for (size_t i = 0; i < call->args.size(); ++i) { allocate(); }
+                for (size_t i = 0; i < call->args.size(); ++i) { compile_expression(call->args[i], base + i); }
+                if (call->builtin) { emit(OpCode::NATIVE, target, call->builtin->index, base, call->args.size()); }
+                else { emit(OpCode::CALL, target, node(call), base, call->args.size()); }
+                break;
+            }
+            default:
+                emit(OpCode::EVAL, target, node(expression));
+                break;
+        }
+        next_register = mark;
+    }
+
+public:
+    BytecodeCompiler(Chunk& chunk) : chunk(chunk) {}
+
+    static Chunk compile(NodePtr block) {
+        Chunk chunk;
+        BytecodeCompiler compiler(chunk);
+        compiler.compile_statement(block);
+        compiler.emit(OpCode::RETNULL);
+        return chunk;
+    }
+
+    // Compiles one while loop so the tiered engine can take it over from the tree-walker at a back-edge. The chunk
+    // runs on the frame of the code around the loop and starts at the condition check.
+    static Chunk compile_loop(NodePtr loop) {
+        Chunk chunk;
+        BytecodeCompiler compiler(chunk);
+        compiler.loop_fragment = true;
+        compiler.compile_statement(loop);
+        compiler.emit(OpCode::RETNULL);
+        return chunk;
+    }
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "Node.h"
+using namespace std;
+
+// Static estimate of what it costs to evaluate a subtree, in units of one simple operation. It only needs to tell
+// cheap arithmetic apart from work that is worth handing to another thread: user function calls and expensive
+// natives such as callprogram (each Builtin carries its own cost).
+namespace cost {
+
+constexpr uint32_t call = 1000;
+// A binary operation forks only when both of its operands cost at least this much
+constexpr uint32_t fork_threshold = call;
+
+inline uint32_t add(uint32_t a, uint32_t b) { return static_cast<uint32_t>(min<uint64_t>(UINT32_MAX, uint64_t(a) + b)); }
+
+// Returns the estimated cost of node and, on the way, decides for every BinOpNode below it whether it runs its
+// operands in parallel
+inline uint32_t annotate(NodePtr node) {
+    if (!node) { return 0; }
+    auto sum = [](const NodeList& nodes) {
+        uint32_t total = 0;
+        for (NodePtr child : nodes) { total = add(total, annotate(child)); }
+        return total;
+    };
+    switch (node->kind) {
+        case NodeKind::BinOp: {
+            auto binop = static_cast<BinOpNode*>(node);
+            uint32_t left = annotate(binop->left);
+            uint32_t right = annotate(binop->right);
+            binop->parallel = left >= fork_threshold && right >= fork_threshold;
+            return add(1, add(left, right));
+        }
+        case NodeKind::UnOp: return add(1, annotate(static_cast<UnOpNode*>(node)->child));
+        case NodeKind::VarDeclare: return add(1, annotate(static_cast<VarDeclareNode*>(node)->expression));
+        case NodeKind::Assignment: return add(1, annotate(static_cast<AssignmentNode*>(node)->expression));
+        case NodeKind::While: {
+            auto loop = static_cast<WhileNode*>(node);
+            return add(annotate(loop->condition), annotate(loop->block));
+        }
+        case NodeKind::If: {
+            auto branch = static_cast<IfNode*>(node);
+            return add(annotate(branch->condition), add(annotate(branch->block), annotate(branch->else_block)));
+        }
+        case NodeKind::FuncDeclare:
+            annotate(static_cast<FuncDeclareNode*>(node)->block_node);
+            return 1;
+        case NodeKind::FuncCall: {
+            auto call_node = static_cast<FuncCallNode*>(node);
+            uint32_t arguments = sum(call_node->args);
+            return add(call_node->builtin ? call_node->builtin->cost : call, arguments);
+        }
+        case NodeKind::Return: return add(1, annotate(static_cast<ReturnNode*>(node)->return_node));
+        case NodeKind::Block: return sum(static_cast<BlockNode*>(node)->statements);
+        case NodeKind::Program: {
+            auto program = static_cast<ProgramNode*>(node);
+            return add(annotate(program->setup_block), annotate(program->main_block));
+        }
+        case NodeKind::Array: return add(1, sum(static_cast<ArrayNode*>(node)->nodes));
+        case NodeKind::ArrayAccess: return add(1, annotate(static_cast<ArrayAccessNode*>(node)->index));
+        case NodeKind::ThreadLoop:
+            annotate(static_cast<ThreadLoopNode*>(node)->block);
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+}
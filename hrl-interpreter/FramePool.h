@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// Per-thread stack of call frames carved out of large chunks. Chunks are never moved or freed, so a frame stays put
+// while deeper calls push and pop above it, and the same storage is reused call after call.
+template <typename T>
+class FramePool {
+private:
+    static constexpr size_t chunk_size = 16 * 1024;
+    struct Chunk {
+        unique_ptr<T[]> items;
+        size_t capacity;
+        size_t used;
+    };
+    vector<Chunk> chunks;
+    size_t current = 0;
+
+    static Chunk make_chunk(size_t count) {
+        size_t capacity = max(chunk_size, count);
+        return { make_unique<T[]>(capacity), capacity, 0 };
+    }
+
+public:
+    static FramePool& local() {
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    T* push(size_t count) {
+        if (chunks.empty()) { chunks.push_back(make_chunk(count)); }
+        if (chunks[current].used + count > chunks[current].capacity) {
+            // A frame never straddles two chunks; every chunk after the current one is empty, so a too-small one is
+            // simply replaced
+            ++current;
+            if (current == chunks.size()) { chunks.push_back(make_chunk(count)); }
+            else if (chunks[current].capacity < count) { chunks[current] = make_chunk(count); }
+        }
+        Chunk& chunk = chunks[current];
+        T* frame = chunk.items.get() + chunk.used;
+        chunk.used += count;
+        return frame;
+    }
+
+    // Frames are popped in the reverse order they were pushed. Their items are reset so a finished call does not
+    // keep its strings and arrays alive.
+    void pop(size_t count) {
+        Chunk& chunk = chunks[current];
+        for (size_t i = chunk.used - count; i < chunk.used; ++i) { chunk.items[i] = T(); }
+        chunk.used -= count;
+        if (chunk.used == 0 && current > 0) { --current; }
+    }
+};
+
+// A frame borrowed from the calling thread's pool for the lifetime of this object
+template <typename T>
+class PooledFrame {
+private:
+    FramePool<T>& pool;
+    size_t count;
+
+public:
+    T* items;
+
+    PooledFrame(size_t count) : pool(FramePool<T>::local()), count(count), items(pool.push(count)) {}
+    PooledFrame(const PooledFrame&) = delete;
+    PooledFrame& operator=(const PooledFrame&) = delete;
+    ~PooledFrame() { pool.pop(count); }
+
+    // Swaps this frame for a cleared one of count items. Only valid while it is the newest frame of its pool; a
+    // frame that fits where the old one was gets the same storage back.
+    void reset(size_t count) {
+        pool.pop(this->count);
+        this->count = count;
+        items = pool.push(count);
+    }
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+using namespace std;
+
+using SymbolId = uint32_t;
+
+// Process-wide identifier table. The tokenizer interns every identifier once, and from then on tokens, AST nodes
+// and the symbol/function tables refer to names by their 32-bit id. Each distinct name is stored exactly once.
+class Interner {
+private:
+    deque<string> names;
+    unordered_map<string_view, SymbolId> ids;
+    mutable shared_mutex lock;
+
+public:
+    static Interner& global() {
+        static Interner interner;
+        return interner;
+    }
+
+    SymbolId intern(string_view name) {
+        {
+            shared_lock<shared_mutex> reader(lock);
+            auto it = ids.find(name);
+            if (it != ids.end()) { return it->second; }
+        }
+        unique_lock<shared_mutex> writer(lock);
+        auto it = ids.find(name);
+        if (it != ids.end()) { return it->second; }
+        SymbolId id = names.size();
+        names.emplace_back(name);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    string_view name(SymbolId id) const {
+        shared_lock<shared_mutex> reader(lock);
+        return names[id];
+    }
+};
+
+inline SymbolId intern(string_view name) { return Interner::global().intern(name); }
+inline string symbol_name(SymbolId id) { return string(Interner::global().name(id)); }
@@ -0,0 +1,758 @@
+#pragma once
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Translates one function, and every function it calls, to C. Only functions that compute with ints and bools are
+// accepted: no strings, arrays, enums, builtins or tail calls to other functions. Anything that would fail at run
+// time (an undefined variable, a division by zero, a callee returning the wrong type) makes the native code give
+// up, and the interpreter repeats the call.
+class CTranslator {
+private:
+    enum class Type : unsigned char { Unknown, Int, Bool, Conflict };
+
+    struct Function {
+        const FuncInfo* info;
+        vector<Type> slots;
+        Type result = Type::Unknown;
+    };
+
+    FuncTable& func_table;
+    vector<Function> functions;
+    unordered_map<const FuncInfo*, size_t> indexes;
+    bool changed = false;
+
+    ostringstream out;
+    size_t current = 0;
+    int depth = 0;
+    int loops = 0;
+    int temporaries = 0;
+
+    [[noreturn]] static void unsupported(const string& reason) { throw runtime_error(reason); }
+
+    const FuncInfo& callee(const FuncCallNode* call) {
+        if (call->builtin) { unsupported("calls builtin " + symbol_name(call->identifier)); }
+        try {
+            const FuncInfo& function = func_table.getFunction(call->identifier);
+            if (function.args.size() != call->args.size()) { unsupported("calls " + symbol_name(call->identifier) + " with the wrong number of arguments"); }
+            return function;
+        }
+        catch (const invalid_argument&) { unsupported("calls undefined function " + symbol_name(call->identifier)); }
+    }
+
+    bool is_self_tail_call(const ReturnNode* ret) {
+        return ret->tail_call && &callee(static_cast<const FuncCallNode*>(ret->return_node)) == functions[current].info;
+    }
+
+    // Adds the function and everything it calls to the unit, rejecting any node C code cannot stand in for
+    size_t collect(const FuncInfo& function) {
+        auto it = indexes.find(&function);
+        if (it != indexes.end()) { return it->second; }
+        if (function.args.size() > MAX_NATIVE_ARGS) { unsupported(symbol_name(function.name) + " has too many parameters"); }
+        // Native callers pass ints without checking them against the callee's declared types
+        for (ValueType type : function.arg_types) {
+            if (type != ValueType::Null && type != ValueType::Int) { unsupported(symbol_name(function.name) + " declares a parameter that is not an int"); }
+        }
+        size_t index = functions.size();
+        indexes.emplace(&function, index);
+        functions.push_back({ &function, vector<Type>(function.frame_size, Type::Unknown) });
+        for (size_t i = 0; i < function.args.size(); ++i) { functions[index].slots[i] = Type::Int; }
+        size_t outer = current;
+        current = index;
+        check(function.block);
+        current = outer;
+        return index;
+    }
+
+    void check(NodePtr node) {
+        switch (node->kind) {
+            case NodeKind::NoOp: case NodeKind::IntVal: case NodeKind::Var: case NodeKind::Break: case NodeKind::Continue: break;
+            case NodeKind::BinOp: {
+                auto binop = static_cast<BinOpNode*>(node);
+                if (binop->op == BinOp::Concat) { unsupported("concatenates strings"); }
+                check(binop->left);
+                check(binop->right);
+                break;
+            }
+            case NodeKind::UnOp: check(static_cast<UnOpNode*>(node)->child); break;
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                if (declare->expression) { check(declare->expression); }
+                else if (declare->declared != ValueType::Null && declare->declared != ValueType::Int && declare->declared != ValueType::Bool) {
+                    unsupported("declares a variable of type " + string(valueTypeName(declare->declared)));
+                }
+                break;
+            }
+            case NodeKind::Assignment: check(static_cast<AssignmentNode*>(node)->expression); break;
+            case NodeKind::While:
+                check(static_cast<WhileNode*>(node)->condition);
+                check(static_cast<WhileNode*>(node)->block);
+                break;
+            case NodeKind::If:
+                check(static_cast<IfNode*>(node)->condition);
+                check(static_cast<IfNode*>(node)->block);
+                check(static_cast<IfNode*>(node)->else_block);
+                break;
+            case NodeKind::Block:
+                for (NodePtr statement : static_cast<BlockNode*>(node)->statements) { check(statement); }
+                break;
+            case NodeKind::Return: {
+                auto ret = static_cast<ReturnNode*>(node);
+                // A chain of tail calls runs in constant stack in the interpreter, which plain C calls would not
+                if (ret->tail_call && !is_self_tail_call(ret)) { unsupported("tail calls " + symbol_name(static_cast<FuncCallNode*>(ret->return_node)->identifier)); }
+                check(ret->return_node);
+                break;
+            }
+            case NodeKind::FuncCall: {
+                auto call = static_cast<FuncCallNode*>(node);
+                const FuncInfo& function = callee(call);
+                for (NodePtr arg : call->args) { check(arg); }
+                try { collect(function); }
+                catch (const runtime_error& error) { unsupported("calls " + symbol_name(function.name) + ", which " + error.what()); }
+                break;
+            }
+            case NodeKind::DoubleVal: unsupported("uses doubles");
+            case NodeKind::StringVal: unsupported("uses strings");
+            case NodeKind::Array: case NodeKind::ArrayAccess: unsupported("uses arrays");
+            case NodeKind::Enum: case NodeKind::EnumVal: unsupported("uses enums");
+            default: unsupported("has statements that only the interpreter runs");
+        }
+    }
+
+    // A declaration without an initializer stores the zero of its declared type
+    static Type default_type(const VarDeclareNode* declare) { return declare->declared == ValueType::Bool ? Type::Bool : Type::Int; }
+
+    void join(Type& type, Type other) {
+        if (other == Type::Unknown || type == other || type == Type::Conflict) { return; }
+        type = type == Type::Unknown ? other : Type::Conflict;
+        changed = true;
+    }
+
+    // Comparisons and logical operators give bools, arithmetic gives ints, whatever the operand types
+    Type type_of(NodePtr node) {
+        switch (node->kind) {
+            case NodeKind::IntVal: return Type::Int;
+            case NodeKind::Var: return functions[current].slots[static_cast<VarNode*>(node)->slot];
+            case NodeKind::BinOp: return static_cast<BinOpNode*>(node)->op <= BinOp::Mod ? Type::Int : Type::Bool;
+            case NodeKind::UnOp: return static_cast<UnOpNode*>(node)->op == UnOp::Not ? Type::Bool : Type::Int;
+            case NodeKind::FuncCall: return functions[indexes[&callee(static_cast<FuncCallNode*>(node))]].result;
+            default: return Type::Unknown;
+        }
+    }
+
+    // Gives every variable and every function result the type of the values stored in it
+    void infer(NodePtr node) {
+        Function& function = functions[current];
+        switch (node->kind) {
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                join(function.slots[declare->slot], declare->expression ? type_of(declare->expression) : default_type(declare));
+                break;
+            }
+            case NodeKind::Assignment:
+                join(function.slots[static_cast<AssignmentNode*>(node)->slot], type_of(static_cast<AssignmentNode*>(node)->expression));
+                break;
+            case NodeKind::While: infer(static_cast<WhileNode*>(node)->block); break;
+            case NodeKind::If:
+                infer(static_cast<IfNode*>(node)->block);
+                infer(static_cast<IfNode*>(node)->else_block);
+                break;
+            case NodeKind::Block:
+                for (NodePtr statement : static_cast<BlockNode*>(node)->statements) { infer(statement); }
+                break;
+            case NodeKind::Return:
+                if (!static_cast<ReturnNode*>(node)->tail_call) { join(function.result, type_of(static_cast<ReturnNode*>(node)->return_node)); }
+                break;
+            default: break;
+        }
+    }
+
+    static string c_type(Type type) { return type == Type::Bool ? "_Bool" : "int"; }
+
+    static string int_literal(int value) {
+        if (value == INT_MIN) { return "(-2147483647 - 1)"; }
+        return value < 0 ? "(" + to_string(value) + ")" : to_string(value);
+    }
+
+    void line(const string& text) { out << string(depth * 4, ' ') << text << "\n"; }
+
+    string temporary() { return "t" + to_string(temporaries++); }
+
+    // The value of node as an int or bool, with every check on the way emitted before it
+    string value(NodePtr node, Type& type) {
+        type = type_of(node);
+        if (type != Type::Int && type != Type::Bool) { unsupported("has an expression of unknown type"); }
+        switch (node->kind) {
+            case NodeKind::IntVal: return int_literal(static_cast<IntValNode*>(node)->value);
+            case NodeKind::Var: {
+                uint32_t slot = static_cast<VarNode*>(node)->slot;
+                if (slot >= functions[current].info->args.size()) { line("if (!d" + to_string(slot) + ") return -1;"); }
+                return "v" + to_string(slot);
+            }
+            case NodeKind::BinOp: {
+                auto binop = static_cast<BinOpNode*>(node);
+                Type left_type, right_type;
+                string left = value(binop->left, left_type);
+                string right = value(binop->right, right_type);
+                string result = temporary();
+                switch (binop->op) {
+                    // Wrapping arithmetic, like the interpreter's ints in practice, without signed overflow
+                    case BinOp::Add: line("int " + result + " = (int)((unsigned)" + left + " + (unsigned)" + right + ");"); break;
+                    case BinOp::Sub: line("int " + result + " = (int)((unsigned)" + left + " - (unsigned)" + right + ");"); break;
+                    case BinOp::Mul: line("int " + result + " = (int)((unsigned)" + left + " * (unsigned)" + right + ");"); break;
+                    case BinOp::Div:
+                    case BinOp::Mod:
+                        line("if (" + right + " == 0 || (" + left + " == (-2147483647 - 1) && " + right + " == -1)) return -1;");
+                        line("int " + result + " = " + left + (binop->op == BinOp::Div ? " / " : " % ") + right + ";");
+                        break;
+                    case BinOp::Eq: line("_Bool " + result + " = " + left + " == " + right + ";"); break;
+                    case BinOp::Ne: line("_Bool " + result + " = " + left + " != " + right + ";"); break;
+                    case BinOp::Lt: line("_Bool " + result + " = " + left + " < " + right + ";"); break;
+                    case BinOp::Le: line("_Bool " + result + " = " + left + " <= " + right + ";"); break;
+                    case BinOp::Gt: line("_Bool " + result + " = " + left + " > " + right + ";"); break;
+                    case BinOp::Ge: line("_Bool " + result + " = " + left + " >= " + right + ";"); break;
+                    case BinOp::And: line("_Bool " + result + " = (" + left + " != 0) & (" + right + " != 0);"); break;
+                    case BinOp::Or: line("_Bool " + result + " = (" + left + " != 0) | (" + right + " != 0);"); break;
+                    default: unsupported("concatenates strings");
+                }
+                return result;
+            }
+            case NodeKind::UnOp: {
+                auto unop = static_cast<UnOpNode*>(node);
+                Type child_type;
+                string child = value(unop->child, child_type);
+                if (child_type != (unop->op == UnOp::Not ? Type::Bool : Type::Int)) {
+                    unsupported(unop->op == UnOp::Not ? "negates a value that is not a bool" : "applies a sign to a value that is not an int");
+                }
+                string result = temporary();
+                switch (unop->op) {
+                    case UnOp::Plus: return child;
+                    case UnOp::Neg: line("int " + result + " = (int)(0u - (unsigned)" + child + ");"); break;
+                    case UnOp::Not: line("_Bool " + result + " = !" + child + ";"); break;
+                }
+                return result;
+            }
+            case NodeKind::FuncCall: {
+                // Native functions hand back bools as ints too
+                string result = temporary();
+                line("int " + result + ";");
+                line("if (" + call(static_cast<FuncCallNode*>(node), "&" + result) + " != " + to_string(static_cast<int>(type == Type::Bool ? NativeResult::Bool : NativeResult::Int)) + ") return -1;");
+                return result;
+            }
+            default: unsupported("has statements that only the interpreter runs");
+        }
+    }
+
+    string call(const FuncCallNode* call, const string& result) {
+        string args;
+        for (NodePtr arg : call->args) {
+            Type type;
+            string value = this->value(arg, type);
+            // Native code only ever receives ints, which the entry point checks for
+            if (type != Type::Int) { unsupported("passes a bool to " + symbol_name(call->identifier)); }
+            args += value + ", ";
+        }
+        return "f" + to_string(indexes[&callee(call)]) + "(" + args + result + ")";
+    }
+
+    void condition(NodePtr node, const string& jump) {
+        Type type;
+        string result = value(node, type);
+        if (type != Type::Bool) { unsupported("has a condition that is not a comparison"); }
+        line("if (!" + result + ") " + jump);
+    }
+
+    void statement(NodePtr node) {
+        switch (node->kind) {
+            case NodeKind::NoOp: break;
+            case NodeKind::Block:
+                for (NodePtr child : static_cast<BlockNode*>(node)->statements) { statement(child); }
+                break;
+            case NodeKind::VarDeclare:
+            case NodeKind::Assignment: {
+                bool declare = node->kind == NodeKind::VarDeclare;
+                uint32_t slot = declare ? static_cast<VarDeclareNode*>(node)->slot : static_cast<AssignmentNode*>(node)->slot;
+                NodePtr expression = declare ? static_cast<VarDeclareNode*>(node)->expression : static_cast<AssignmentNode*>(node)->expression;
+                ValueType checked = declare ? static_cast<VarDeclareNode*>(node)->checked : static_cast<AssignmentNode*>(node)->checked;
+                Type type = declare ? default_type(static_cast<VarDeclareNode*>(node)) : Type::Int;
+                string result = expression ? value(expression, type) : "0";
+                if (type != functions[current].slots[slot]) { unsupported("stores values of different types in one variable"); }
+                // A store the interpreter checks at run time must be one that always passes
+                if (checked != ValueType::Null && checked != (type == Type::Int ? ValueType::Int : ValueType::Bool)) { unsupported("stores a value of the wrong declared type"); }
+                line("v" + to_string(slot) + " = " + result + ";");
+                if (slot >= functions[current].info->args.size()) { line("d" + to_string(slot) + " = 1;"); }
+                break;
+            }
+            case NodeKind::While: {
+                auto loop = static_cast<WhileNode*>(node);
+                line("for (;;) {");
+                ++depth;
+                condition(loop->condition, "break;");
+                ++loops;
+                statement(loop->block);
+                --loops;
+                --depth;
+                line("}");
+                break;
+            }
+            case NodeKind::If: {
+                auto branch = static_cast<IfNode*>(node);
+                Type type;
+                string result = value(branch->condition, type);
+                if (type != Type::Bool) { unsupported("has a condition that is not a comparison"); }
+                line("if (" + result + ") {");
+                ++depth;
+                statement(branch->block);
+                --depth;
+                if (branch->else_block->kind != NodeKind::NoOp) {
+                    line("} else {");
+                    ++depth;
+                    statement(branch->else_block);
+                    --depth;
+                }
+                line("}");
+                break;
+            }
+            case NodeKind::Return: {
+                auto ret = static_cast<ReturnNode*>(node);
+                if (ret->tail_call) {
+                    // Arguments are all evaluated before the parameters change, then the body starts over
+                    auto call = static_cast<FuncCallNode*>(ret->return_node);
+                    vector<string> args;
+                    for (NodePtr arg : call->args) {
+                        Type type;
+                        string value = this->value(arg, type);
+                        string result = temporary();
+                        line("int " + result + " = " + value + ";");
+                        if (type != Type::Int) { unsupported("passes a bool to " + symbol_name(call->identifier)); }
+                        args.push_back(result);
+                    }
+                    for (size_t i = 0; i < args.size(); ++i) { line("v" + to_string(i) + " = " + args[i] + ";"); }
+                    line("goto entry;");
+                    break;
+                }
+                Type type;
+                string result = value(ret->return_node, type);
+                line("*result = " + result + ";");
+                line("return " + to_string(static_cast<int>(type == Type::Bool ? NativeResult::Bool : NativeResult::Int)) + ";");
+                break;
+            }
+            // Outside a loop, break and continue end the function, which then returns null
+            case NodeKind::Break: line(loops ? "break;" : "return " + to_string(static_cast<int>(NativeResult::Null)) + ";"); break;
+            case NodeKind::Continue: line(loops ? "continue;" : "return " + to_string(static_cast<int>(NativeResult::Null)) + ";"); break;
+            case NodeKind::FuncCall: {
+                string result = temporary();
+                line("int " + result + ";");
+                line("if (" + call(static_cast<FuncCallNode*>(node), "&" + result) + " < 0) return -1;");
+                break;
+            }
+            default: {
+                // An expression statement: only its checks matter
+                Type type;
+                line("(void)" + value(node, type) + ";");
+                break;
+            }
+        }
+    }
+
+    string signature(size_t index) {
+        string params;
+        for (size_t i = 0; i < functions[index].info->args.size(); ++i) { params += "int p" + to_string(i) + ", "; }
+        return "static int f" + to_string(index) + "(" + params + "int* result)";
+    }
+
+    void function(size_t index) {
+        const Function& function = functions[index];
+        current = index;
+        temporaries = 0;
+        size_t arity = function.info->args.size();
+        line("/* " + symbol_name(function.info->name) + " */");
+        line(signature(index) + " {");
+        ++depth;
+        for (size_t slot = 0; slot < function.slots.size(); ++slot) {
+            string type = c_type(function.slots[slot]);
+            if (slot < arity) { line("int v" + to_string(slot) + " = p" + to_string(slot) + ";"); }
+            else { line(type + " v" + to_string(slot) + " = 0;"); }
+        }
+        for (size_t slot = arity; slot < function.slots.size(); ++slot) { line("unsigned char d" + to_string(slot) + ";"); }
+        --depth;
+        line("entry:;");
+        ++depth;
+        // A call, and a self tail call, starts with only the parameters defined
+        for (size_t slot = arity; slot < function.slots.size(); ++slot) { line("d" + to_string(slot) + " = 0;"); }
+        statement(function.info->block);
+        line("return " + to_string(static_cast<int>(NativeResult::Null)) + ";");
+        --depth;
+        line("}");
+        line("");
+    }
+
+public:
+    CTranslator(FuncTable& func_table) : func_table(func_table) {}
+
+    // Functions in the order of their hrl_entry_<index> symbols; the first is the one the unit was made for
+    vector<const FuncInfo*> unit() const {
+        vector<const FuncInfo*> result;
+        for (const Function& function : functions) { result.push_back(function.info); }
+        return result;
+    }
+
+    // Throws runtime_error with the reason when the function cannot be compiled
+    string run(const FuncInfo& root) {
+        collect(root);
+        // Types only ever move from Unknown towards Conflict, so this settles after a few passes
+        do {
+            changed = false;
+            for (current = 0; current < functions.size(); ++current) { infer(functions[current].info->block); }
+        } while (changed);
+        for (const Function& function : functions) {
+            for (Type type : function.slots) {
+                if (type == Type::Conflict) { unsupported("stores values of different types in one variable"); }
+            }
+            if (function.result == Type::Conflict) { unsupported("returns values of different types"); }
+        }
+
+        for (size_t i = 0; i < functions.size(); ++i) { line(signature(i) + ";"); }
+        line("");
+        for (size_t i = 0; i < functions.size(); ++i) { function(i); }
+        for (size_t i = 0; i < functions.size(); ++i) {
+            string args;
+            for (size_t arg = 0; arg < functions[i].info->args.size(); ++arg) { args += "args[" + to_string(arg) + "], "; }
+            line("int hrl_entry_" + to_string(i) + "(const int* args, int* result) { (void)args; return f" + to_string(i) + "(" + args + "result); }");
+        }
+        return out.str();
+    }
+};
+
+// Compiles hot functions to native code with the system C compiler. The tiered engine hands over every function it
+// promotes; the translation to C happens right away, the compiler runs on a background thread and the library is
+// loaded with dlopen, after which the function's FuncInfo points at it. Libraries are cached on disk under a hash of
+// their C source, so a restarted script loads them instead of compiling again. The cache must be a directory only its
+// owner can write; without one, each library is built in a private temporary directory that is removed once loaded.
+class NativeJit {
+private:
+    struct Unit {
+        string name;
+        string source;
+        uint64_t key;
+        vector<const FuncInfo*> functions;
+        // How the library was obtained, or why it could not be
+        string detail = "";
+    };
+
+    struct Outcome {
+        string name;
+        string detail;
+    };
+
+    FuncTable& func_table;
+    string compiler;
+    // Empty when there is no cache, with the reason in cache_note
+    string cache_dir;
+    string cache_note = "";
+    mutex lock;
+    condition_variable wake;
+    deque<Unit> queue;
+    unordered_set<const FuncInfo*> requested;
+    vector<Outcome> compiled, rejected;
+    bool stopping = false;
+    thread worker;
+    // Without a cache, the directory the library being built goes to
+    string temporary_dir = "";
+
+    // 64-bit FNV-1a
+    static uint64_t fnv1a(const string& text) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static string shell_quote(const string& text) {
+        string result = "'";
+        for (char c : text) {
+            if (c == '\'') { result += "'\\''"; }
+            else { result += c; }
+        }
+        return result + "'";
+    }
+
+    // Empty if none is configured: a shared fallback such as /tmp would let other users plant libraries
+    static string default_cache_dir() {
+        if (const char* dir = getenv("HRL_JIT_CACHE")) { return dir; }
+        if (const char* dir = getenv("XDG_CACHE_HOME")) { return string(dir) + "/hrl-jit"; }
+        if (const char* dir = getenv("HOME")) { return string(dir) + "/.cache/hrl-jit"; }
+        return "";
+    }
+
+    // Whether path is a file of the given type (not a symlink) owned by us that nobody else can write
+    static bool trusted(const string& path, mode_t type) {
+        struct stat info;
+        return lstat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == type && info.st_uid == geteuid()
+            && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+    }
+
+    // Creates the file, failing rather than following a symlink or reusing one that is already there
+    static bool write_new_file(const string& path, const string& text) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+        if (fd < 0) { return false; }
+        size_t written = 0;
+        while (written < text.size()) {
+            ssize_t count = write(fd, text.data() + written, text.size() - written);
+            if (count < 0 && errno == EINTR) { continue; }
+            if (count <= 0) { break; }
+            written += count;
+        }
+        return close(fd) == 0 && written == text.size();
+    }
+
+    string command() const { return compiler + " -O2 -shared -fPIC"; }
+
+    void request_locked(const FuncInfo& function) {
+        if (!requested.insert(&function).second) { return; }
+        CTranslator translator(func_table);
+        try {
+            string source = translator.run(function);
+            vector<const FuncInfo*> functions = translator.unit();
+            for (const FuncInfo* member : functions) { requested.insert(member); }
+            // The compiler and its flags are part of the key, so changing either never loads a stale library
+            Unit unit{ symbol_name(function.name), source, fnv1a(command() + "\n" + source), move(functions) };
+            // A library built by an earlier run is loaded right away; only new ones wait for the compiler
+            string library = library_path(cache_dir, unit);
+            if (!cache_dir.empty() && trusted(library, S_IFREG)) {
+                unit.detail = "loaded from cache";
+                void* handle = open(library, unit.detail);
+                install(unit, handle, unit.detail);
+                return;
+            }
+            queue.push_back(move(unit));
+            if (!worker.joinable()) { worker = thread(&NativeJit::work, this); }
+            wake.notify_one();
+        }
+        catch (const runtime_error& error) {
+            rejected.push_back({ symbol_name(function.name), error.what() });
+            // What it calls may still be worth compiling on its own
+            request_calls_locked(function.block);
+        }
+    }
+
+    void request_calls_locked(NodePtr node) {
+        if (!node) { return; }
+        auto each = [&](NodeList nodes) { for (NodePtr child : nodes) { request_calls_locked(child); } };
+        switch (node->kind) {
+            case NodeKind::BinOp:
+                request_calls_locked(static_cast<BinOpNode*>(node)->left);
+                request_calls_locked(static_cast<BinOpNode*>(node)->right);
+                break;
+            case NodeKind::UnOp: request_calls_locked(static_cast<UnOpNode*>(node)->child); break;
+            case NodeKind::VarDeclare: request_calls_locked(static_cast<VarDeclareNode*>(node)->expression); break;
+            case NodeKind::Assignment: request_calls_locked(static_cast<AssignmentNode*>(node)->expression); break;
+            case NodeKind::While:
+                request_calls_locked(static_cast<WhileNode*>(node)->condition);
+                request_calls_locked(static_cast<WhileNode*>(node)->block);
+                break;
+            case NodeKind::If:
+                request_calls_locked(static_cast<IfNode*>(node)->condition);
+                request_calls_locked(static_cast<IfNode*>(node)->block);
+                request_calls_locked(static_cast<IfNode*>(node)->else_block);
+                break;
+            case NodeKind::FuncCall: {
+                auto call = static_cast<FuncCallNode*>(node);
+                each(call->args);
+                if (call->builtin) { break; }
+                try { request_locked(func_table.getFunction(call->identifier)); }
+                catch (const invalid_argument&) {}
+                break;
+            }
+            case NodeKind::Return: request_calls_locked(static_cast<ReturnNode*>(node)->return_node); break;
+            case NodeKind::Block: each(static_cast<BlockNode*>(node)->statements); break;
+            case NodeKind::Array: each(static_cast<ArrayNode*>(node)->nodes); break;
+            case NodeKind::ArrayAccess: request_calls_locked(static_cast<ArrayAccessNode*>(node)->index); break;
+            default: break;
+        }
+    }
+
+    static string library_path(const string& dir, const Unit& unit) {
+        char name[32];
+        snprintf(name, sizeof(name), "hrl_%016llx.so", static_cast<unsigned long long>(unit.key));
+        return dir + "/" + name;
+    }
+
+    // Libraries stay loaded for the life of the process, since any thread may be running their code
+    static void* open(const string& library, string& detail) {
+        void* handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) { detail = string("dlopen failed: ") + dlerror(); }
+        return handle;
+    }
+
+    // Not system(), which ignores SIGINT in the whole process until the command ends, so Ctrl-C during a build was lost
+    static bool run_shell(const string& command) {
+        const char* argv[] = { "sh", "-c", command.c_str(), nullptr };
+        pid_t pid;
+        if (posix_spawn(&pid, "/bin/sh", nullptr, nullptr, const_cast<char* const*>(argv), environ) != 0) { return false; }
+        int status;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) { return false; }
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    // Builds the unit's library into dir; returns false with the reason if that fails
+    bool build(Unit& unit, const string& dir) {
+        auto start = chrono::steady_clock::now();
+        string library = library_path(dir, unit);
+        string base = library.substr(0, library.size() - 3);
+        // Write under names of our own and move files into place whole, so other processes sharing the cache never
+        // see a half-written one. The shell moves the library, which still happens if we exit first.
+        string temporary = base + "." + to_string(getpid()) + ".tmp";
+        string source = base + ".c";
+        // Left behind by an earlier process with our pid that was killed mid-build
+        unlink(temporary.c_str());
+        if (!write_new_file(temporary, unit.source)) {
+            unit.detail = "cannot write " + temporary;
+            return false;
+        }
+        error_code error;
+        filesystem::rename(temporary, source, error);
+        if (error) {
+            unit.detail = "cannot write " + source;
+            return false;
+        }
+        string command = this->command() + " -o " + shell_quote(temporary) + " " + shell_quote(source) + " 2>/dev/null && mv -f " + shell_quote(temporary) + " " + shell_quote(library);
+        if (!run_shell(command)) {
+            unit.detail = "compiler failed (" + this->command() + ")";
+            return false;
+        }
+        unit.detail = "compiled in " + to_string(chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count()) + " ms";
+        return true;
+    }
+
+    // A loaded library stays mapped after its file is removed. Needs the lock.
+    void remove_temporary_locked() {
+        if (temporary_dir.empty()) { return; }
+        error_code error;
+        filesystem::remove_all(temporary_dir, error);
+        temporary_dir.clear();
+    }
+
+    // Points every function of the unit at its native code, unless another unit got there first. Needs the lock.
+    void install(const Unit& unit, void* handle, const string& detail) {
+        for (size_t i = 0; i < unit.functions.size(); ++i) {
+            string name = symbol_name(unit.functions[i]->name);
+            auto entry = handle ? reinterpret_cast<NativeEntry>(dlsym(handle, ("hrl_entry_" + to_string(i)).c_str())) : nullptr;
+            if (!entry) {
+                rejected.push_back({ name, handle ? "missing from its library" : detail });
+                continue;
+            }
+            NativeEntry expected = nullptr;
+            unit.functions[i]->native.compare_exchange_strong(expected, entry, memory_order_release);
+            compiled.push_back({ name, i == 0 ? detail : "with " + unit.name });
+        }
+    }
+
+    void work() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [&] { return stopping || !queue.empty(); });
+            if (stopping) { return; }
+            Unit unit = move(queue.front());
+            queue.pop_front();
+            // Without a cache the library is built in a directory of its own, removed once it is loaded
+            string dir = cache_dir;
+            if (dir.empty()) {
+                char name[] = "/tmp/hrl-jit-XXXXXX";
+                if (mkdtemp(name)) { dir = temporary_dir = name; }
+            }
+            guard.unlock();
+            void* handle = nullptr;
+            if (dir.empty()) { unit.detail = "cannot create a temporary directory"; }
+            else if (build(unit, dir)) { handle = open(library_path(dir, unit), unit.detail); }
+            guard.lock();
+            remove_temporary_locked();
+            install(unit, handle, unit.detail);
+        }
+    }
+
+public:
+    explicit NativeJit(FuncTable& func_table)
+        : func_table(func_table), compiler(getenv("CC") ? getenv("CC") : "cc"), cache_dir(default_cache_dir()) {
+        if (cache_dir.empty()) {
+            cache_note = "none configured";
+            return;
+        }
+        error_code error;
+        filesystem::path parent = filesystem::path(cache_dir).parent_path();
+        if (!parent.empty()) { filesystem::create_directories(parent, error); }
+        mkdir(cache_dir.c_str(), 0700);
+        if (!trusted(cache_dir, S_IFDIR)) {
+            cache_note = cache_dir + " is not a directory that only its owner can write";
+            cache_dir.clear();
+        }
+    }
+
+    NativeJit(const NativeJit&) = delete;
+    NativeJit& operator=(const NativeJit&) = delete;
+
+    // Waits for the library being built, if any; queued ones are dropped
+    ~NativeJit() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable()) { worker.join(); }
+    }
+
+    // For the way out of the process, where destructors may not run: stops building and removes temporary files
+    void shut_down() {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+        remove_temporary_locked();
+    }
+
+    // Called by the tiered engine for every function it promotes
+    void request(const FuncInfo& function) {
+        lock_guard<mutex> guard(lock);
+        request_locked(function);
+    }
+
+    // Called for every promoted loop, which the JIT cannot take, for the functions called in it
+    void request_calls(const Node* loop) {
+        lock_guard<mutex> guard(lock);
+        request_calls_locked(const_cast<NodePtr>(loop));
+    }
+
+    void print_stats(ostream& out) {
+        lock_guard<mutex> guard(lock);
+        out << "  Functions compiled to native code: " << compiled.size() << " (" << (cache_dir.empty() ? "no cache, " + cache_note : "cache " + cache_dir) << ")" << endl;
+        for (const Outcome& outcome : compiled) { out << "    " << outcome.name << ": " << outcome.detail << endl; }
+        if (!queue.empty()) { out << "  Native compilations still queued: " << queue.size() << endl; }
+        out << "  Functions left to bytecode: " << rejected.size() << endl;
+        for (const Outcome& outcome : rejected) { out << "    " << outcome.name << ": " << outcome.detail << endl; }
+    }
+};
@@ -1,4 +1,6 @@
+#pragma once
 #include <omp.h>
+#include <atomic>
 #include <thread>
 #include <iostream>
 #include <memory>
@@ -7,486 +9,570 @@
 #include <sstream>
 #include <unordered_map>
 #include <vector>
-#include <variant>
+#include "Arena.h"
+#include "Builtins.h"
+#include "Operators.h"
 #include "SymbolTable.h"
 using namespace std;
 
-template <typename T>
-string join(const vector<T>& vec, const string& delimiter) {
-    stringstream ss;
-    for (size_t i = 0; i < vec.size(); ++i) {
-        if (i != 0) ss << delimiter;
-        ss << vec[i];
-    }
-    return ss.str();
-}
-
 class Node;
-using NodePtr = shared_ptr<Node>;
-using EvalResult = variant<int, string, double, bool, vector<int>, vector<string>, vector<double>, vector<bool>>;
+using NodePtr = Node*;
+using NodeList = ArenaSpan<NodePtr>;
+
+enum class NodeKind : unsigned char {
+    BinOp, UnOp, NoOp, IntVal, DoubleVal, StringVal, Var, VarDeclare, Assignment, While, If,
+    FuncDeclare, FuncCall, Return, Break, Continue, Block, Program, Enum, EnumVal, Struct, StructField, Array,
+    ArrayAccess, ThreadLoop
+};
 
+// Nodes are allocated in an Arena owned by whoever ran the parser; child pointers are non-owning
 class Node {
 public:
-    vector<NodePtr> statements;
-    string type;
-    static int i;
-    int id;
-    static int newId() { return ++i; }
-    Node() : id(newId()) {}
+    NodeKind kind;
+    // Set by the type checker when every value of this expression is known to have one type, otherwise Null
+    ValueType type = ValueType::Null;
+    Node(NodeKind kind) : kind(kind) {}
     virtual EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const = 0;
-    void add_statement(NodePtr statement) { statements.push_back(statement); }
+    // Unboxed evaluation, only called on expressions whose type is Int, Double or Bool respectively
+    virtual int EvaluateInt(SymbolTable& symbol_table, FuncTable& func_table) const { return Evaluate(symbol_table, func_table).int_unchecked(); }
+    virtual double EvaluateDouble(SymbolTable& symbol_table, FuncTable& func_table) const { return Evaluate(symbol_table, func_table).double_unchecked(); }
+    virtual bool EvaluateBool(SymbolTable& symbol_table, FuncTable& func_table) const { return Evaluate(symbol_table, func_table).bool_unchecked(); }
+    // Condition of an if or while
+    bool Test(SymbolTable& symbol_table, FuncTable& func_table) const {
+        if (type == ValueType::Bool) { return EvaluateBool(symbol_table, func_table); }
+        return Evaluate(symbol_table, func_table).as_bool();
+    }
 };
 
-int Node::i = 0;
-
 class BinOpNode : public Node {
 public:
-    BinOpNode(string op, NodePtr left, NodePtr right) : op(op), left(move(left)), right(move(right)) {type = "BinOpNode";}
+    BinOpNode(BinOp op, NodePtr left, NodePtr right) : Node(NodeKind::BinOp), op(op), left(move(left)), right(move(right)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        EvalResult right_value, left_value;
-        #pragma omp parallel sections
-        {
-            #pragma omp section
-            {
-                right_value = right->Evaluate(symbol_table, func_table);
-            }
-            #pragma omp section
+        // Only fork when the cost model marked both operands as expensive and no enclosing region already did
+        if (parallel && !omp_in_parallel()) {
+            EvalResult right_value, left_value;
+            #pragma omp parallel sections
             {
-                left_value = left->Evaluate(symbol_table, func_table);
+                #pragma omp section
+                {
+                    right_value = right->Evaluate(symbol_table, func_table);
+                }
+                #pragma omp section
+                {
+                    left_value = left->Evaluate(symbol_table, func_table);
+                }
             }
+            return ops::apply(op, left_value, right_value);
         }
-        if (op != ".." && (holds_alternative<string>(left_value) != holds_alternative<string>(right_value))) {
-            throw invalid_argument("Unsupported operation on string type");
+        if (operands == ValueType::Int && type != ValueType::String) {
+            int left_value = left->EvaluateInt(symbol_table, func_table);
+            int right_value = right->EvaluateInt(symbol_table, func_table);
+            if (type == ValueType::Int) { return EvalResult(ops::arithmetic(op, left_value, right_value)); }
+            return EvalResult(ops::compare(op, left_value, right_value));
         }
-        if (op == "..") { 
-            string left_str;
-            string right_str;
-            if (holds_alternative<int>(left_value)) { left_str = to_string(get<int>(left_value)); }
-            else if (holds_alternative<double>(left_value)) { left_str = to_string(get<double>(left_value)); }
-            else if (holds_alternative<string>(left_value)) { left_str = get<string>(left_value); }
-            else if (holds_alternative<bool>(left_value)) { left_str = get<bool>(left_value) ? "1" : "0"; }
-            if (holds_alternative<int>(right_value)) { right_str = to_string(get<int>(right_value)); }
-            else if (holds_alternative<double>(right_value)) { right_str = to_string(get<double>(right_value)); }
-            else if (holds_alternative<string>(right_value)) { right_str = get<string>(right_value); }
-            else if (holds_alternative<bool>(right_value)) { right_str = get<bool>(right_value) ? "1" : "0"; }
-            return EvalResult(left_str + right_str);
+        if (operands == ValueType::Double && type != ValueType::String) {
+            double left_value = promoted(left, symbol_table, func_table);
+            double right_value = promoted(right, symbol_table, func_table);
+            if (type == ValueType::Double) { return EvalResult(ops::arithmetic(op, left_value, right_value)); }
+            return EvalResult(ops::compare(op, left_value, right_value));
         }
-        else if (op == "+" || op == "-" || op == "*" || op == "/" || op == "%") {
-            int left_int;
-            int right_int;
-            if (holds_alternative<int>(left_value)) { left_int = get<int>(left_value); }
-            else if (holds_alternative<double>(left_value)) { left_int = get<double>(left_value); }
-            else if (holds_alternative<bool>(left_value)) { left_int = get<bool>(left_value); }
-            if (holds_alternative<int>(right_value)) { right_int = get<int>(right_value); }
-            else if (holds_alternative<double>(right_value)) { right_int = get<double>(right_value); }
-            else if (holds_alternative<bool>(right_value)) { right_int = get<bool>(right_value); }
-            if (op == "+") { return EvalResult(left_int + right_int); }
-            else if (op == "-") { return EvalResult(left_int - right_int); }
-            else if (op == "*") { return EvalResult(left_int * right_int); }
-            else if (op == "/") {
-                if (right_int == 0) { throw invalid_argument("Division by zero"); }
-                return EvalResult(left_int / right_int);
-            }
-            else if (op == "%") {
-                if (right_int == 0) { throw invalid_argument("Division by zero"); }
-                return EvalResult(left_int % right_int);
-            }
+        EvalResult left_value = left->Evaluate(symbol_table, func_table);
+        EvalResult right_value = right->Evaluate(symbol_table, func_table);
+        return ops::apply(op, left_value, right_value);
+    }
+
+    // Operands proven to be of one numeric or bool type skip boxing and the type dispatch in ops::apply
+    int EvaluateInt(SymbolTable& symbol_table, FuncTable& func_table) const override {
+        if (parallel || (operands != ValueType::Int && operands != ValueType::Bool)) { return Evaluate(symbol_table, func_table).int_unchecked(); }
+        int left_value = operands == ValueType::Int ? left->EvaluateInt(symbol_table, func_table) : left->EvaluateBool(symbol_table, func_table);
+        int right_value = operands == ValueType::Int ? right->EvaluateInt(symbol_table, func_table) : right->EvaluateBool(symbol_table, func_table);
+        return ops::arithmetic(op, left_value, right_value);
+    }
+
+    double EvaluateDouble(SymbolTable& symbol_table, FuncTable& func_table) const override {
+        if (parallel || operands != ValueType::Double) { return Evaluate(symbol_table, func_table).double_unchecked(); }
+        double left_value = promoted(left, symbol_table, func_table);
+        double right_value = promoted(right, symbol_table, func_table);
+        return ops::arithmetic(op, left_value, right_value);
+    }
+
+    bool EvaluateBool(SymbolTable& symbol_table, FuncTable& func_table) const override {
+        if (parallel) { return Evaluate(symbol_table, func_table).bool_unchecked(); }
+        if (operands == ValueType::Int) {
+            int left_value = left->EvaluateInt(symbol_table, func_table);
+            int right_value = right->EvaluateInt(symbol_table, func_table);
+            return ops::compare(op, left_value, right_value);
         }
-        else if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=") { 
-            int left_int;
-            int right_int;
-            if (holds_alternative<int>(left_value)) { left_int = get<int>(left_value); }
-            else if (holds_alternative<double>(left_value)) { left_int = get<double>(left_value); }
-            else if (holds_alternative<bool>(left_value)) { left_int = get<bool>(left_value); }
-            if (holds_alternative<int>(right_value)) { right_int = get<int>(right_value); }
-            else if (holds_alternative<double>(right_value)) { right_int = get<double>(right_value); }
-            else if (holds_alternative<bool>(right_value)) { right_int = get<bool>(right_value); }
-            if (holds_alternative<string>(left_value) && holds_alternative<string>(right_value)) {
-                if (op == "==") { return EvalResult(get<string>(left_value) == get<string>(right_value)); }
-                else if (op == "!=") { return EvalResult(get<string>(left_value) != get<string>(right_value)); }
-                else if (op == "<") { return EvalResult(get<string>(left_value) < get<string>(right_value)); }
-                else if (op == "<=") { return EvalResult(get<string>(left_value) <= get<string>(right_value)); }
-                else if (op == ">") { return EvalResult(get<string>(left_value) > get<string>(right_value)); }
-                else if (op == ">=") { return EvalResult(get<string>(left_value) >= get<string>(right_value)); }
-                else { throw invalid_argument("Invalid operation on string type"); }
-            }
-            if (op == "==") { return EvalResult(left_int == right_int); }
-            else if (op == "!=") { return EvalResult(left_int != right_int); }
-            else if (op == "<") { return EvalResult(left_int < right_int); }
-            else if (op == "<=") { return EvalResult(left_int <= right_int); }
-            else if (op == ">") { return EvalResult(left_int > right_int); }
-            else if (op == ">=") { return EvalResult(left_int >= right_int); }
-            else if (op == "and") { return EvalResult(left_int && right_int); }
-            else if (op == "or") { return EvalResult(left_int || right_int); }
+        if (operands == ValueType::Double) {
+            double left_value = promoted(left, symbol_table, func_table);
+            double right_value = promoted(right, symbol_table, func_table);
+            return ops::compare(op, left_value, right_value);
         }
-        else if (op == "and" || op == "or") {
-            bool left_bool;
-            bool right_bool;
-            if (holds_alternative<int>(left_value)) { left_bool = get<int>(left_value) != 0; }
-            else if (holds_alternative<double>(left_value)) { left_bool = get<double>(left_value) != 0; }
-            else if (holds_alternative<bool>(left_value)) { left_bool = get<bool>(left_value); }
-            if (holds_alternative<int>(right_value)) { right_bool = get<int>(right_value) != 0; }
-            else if (holds_alternative<double>(right_value)) { right_bool = get<double>(right_value) != 0; }
-            else if (holds_alternative<bool>(right_value)) { right_bool = get<bool>(right_value); }
-            if (op == "and") { return EvalResult(left_bool && right_bool); }
-            else if (op == "or") { return EvalResult(left_bool || right_bool); }
+        if (operands == ValueType::Bool) {
+            bool left_value = left->EvaluateBool(symbol_table, func_table);
+            bool right_value = right->EvaluateBool(symbol_table, func_table);
+            return ops::compare(op, left_value, right_value);
+        }
+        return Evaluate(symbol_table, func_table).bool_unchecked();
+    }
+
+    // Operand of a double operation, which may be an int or bool the operation promotes
+    static double promoted(NodePtr operand, SymbolTable& symbol_table, FuncTable& func_table) {
+        switch (operand->type) {
+            case ValueType::Int: return operand->EvaluateInt(symbol_table, func_table);
+            case ValueType::Bool: return operand->EvaluateBool(symbol_table, func_table);
+            default: return operand->EvaluateDouble(symbol_table, func_table);
         }
-        else { throw invalid_argument("Invalid binary operation"); }
-        return EvalResult(0);
     }
-private:
-    string op;
+
+    BinOp op;
+    bool parallel = false;
+    // Int or Bool when the type checker proved both operands to have that type, Double when both are numbers and
+    // at least one is a double, otherwise Null
+    ValueType operands = ValueType::Null;
     NodePtr left, right;
 };
 
 class UnOpNode : public Node {
 public:
-    UnOpNode(string op, NodePtr child) : op(op), child(move(child)) {type = "UnOpNode";}
+    UnOpNode(UnOp op, NodePtr child) : Node(NodeKind::UnOp), op(op), child(move(child)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        EvalResult child_value = child->Evaluate(symbol_table, func_table);
-        if (op == "+") { return get<int>(child_value); }
-        else if (op == "-") { return -get<int>(child_value); }
-        else if (op == "not") { return !get<bool>(child_value); }
-        else { throw invalid_argument("Invalid unary operation"); }
-    }
-private:
-    string op;
+        return ops::unary(op, child->Evaluate(symbol_table, func_table));
+    }
+    UnOp op;
     NodePtr child;
 };
 
 class NoOpNode : public Node {
 public:
-    NoOpNode() {type = "NoOpNode";}
+    NoOpNode() : Node(NodeKind::NoOp) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override { 
-        return EvalResult("NULL"); 
+        return EvalResult(); 
     }
 };
 
 class IntValNode : public Node {
 public:
-    IntValNode(int val) : value(val) {type = "IntValNode";}
+    IntValNode(int val) : Node(NodeKind::IntVal), value(val) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         return EvalResult(value);
     }
-private:
+    int EvaluateInt(SymbolTable& symbol_table, FuncTable& func_table) const override { return value; }
     int value;
 };
 
-class StringValNode : public Node {
+class DoubleValNode : public Node {
 public:
-    StringValNode(string val) : value(val) {type = "StringValNode";}
-    EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override { 
+    DoubleValNode(double val) : Node(NodeKind::DoubleVal), value(val) {}
+    EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         return EvalResult(value);
     }
-private:
-    string value;
+    double EvaluateDouble(SymbolTable& symbol_table, FuncTable& func_table) const override { return value; }
+    double value;
 };
 
-class VarNode : public Node {
+class StringValNode : public Node {
 public:
-    VarNode(string identifier) : identifier(identifier) {type = "VarNode";}
+    StringValNode(string val) : Node(NodeKind::StringVal), value(val) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override { 
-        return symbol_table.getVariable(identifier); 
-    }
-private:
-    string identifier;
-};
-
-class ReadNode : public Node {
-public:
-    ReadNode() {type = "ReadNode";}
-    EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        int value;
-        cin >> value;
         return EvalResult(value);
     }
+    string value;
 };
 
-class PrintNode : public Node {
-public:
-    PrintNode(NodePtr expression) : expression(move(expression)) {type = "PrintNode";}
-    EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        EvalResult result = expression->Evaluate(symbol_table, func_table);
-        if (holds_alternative<int>(result)) { cout << get<int>(result) << endl; }
-        else if (holds_alternative<string>(result)) { cout << get<string>(result) << endl; }
-        else if (holds_alternative<double>(result)) { cout << get<double>(result) << endl; }
-        else if (holds_alternative<bool>(result)) { cout << get<bool>(result) << endl; }
-        return result;
-    }
-private:
-    NodePtr expression;
-};
-
-class CallProgramNode : public Node {
+class VarNode : public Node {
 public:
-    CallProgramNode(NodePtr program_name_expression, const vector<NodePtr>& args) : program_name_expression(move(program_name_expression)), args(args) {type = "CallProgramNode";}
-    EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        string program_name = get<string>(program_name_expression->Evaluate(symbol_table, func_table));
-        vector<string> args_strings(args.size());
-        #pragma omp parallel for
-        for (size_t i = 0; i < args.size(); ++i) {
-            args_strings[i] = get<string>(args[i]->Evaluate(symbol_table, func_table));
-        }
-        if (program_name.find(".py") != string::npos) {
-            string command = "python " + program_name + " " + join(args_strings, " ");
-            return EvalResult(system(command.c_str()));
-        }
-        else if (program_name.find(".lua") != string::npos) {
-            string command = "lua " + program_name + " " + join(args_strings, " ");
-            return EvalResult(system(command.c_str()));
-        }
-        else {
-            string command = "./" + program_name + " " + join(args_strings, " ");
-            return EvalResult(system(command.c_str()));
-        }
+    VarNode(SymbolId identifier) : Node(NodeKind::Var), identifier(identifier) {}
+    EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override { 
+        return symbol_table.getVariable(slot, identifier); 
     }
-private:
-    NodePtr program_name_expression;
-    vector<NodePtr> args;
+    int EvaluateInt(SymbolTable& symbol_table, FuncTable& func_table) const override { return symbol_table.getVariable(slot, identifier).int_unchecked(); }
+    double EvaluateDouble(SymbolTable& symbol_table, FuncTable& func_table) const override { return symbol_table.getVariable(slot, identifier).double_unchecked(); }
+    bool EvaluateBool(SymbolTable& symbol_table, FuncTable& func_table) const override { return symbol_table.getVariable(slot, identifier).bool_unchecked(); }
+    SymbolId identifier;
+    uint32_t slot = 0;
 };
 
 class VarDeclareNode : public Node {
 public:
-    VarDeclareNode(string identifier, NodePtr expression = make_shared<IntValNode>(0))
-        : identifier(identifier), expression(move(expression)) {type = "VarDeclareNode";}
+    VarDeclareNode(SymbolId identifier, NodePtr expression = nullptr, bool is_const = false)
+        : Node(NodeKind::VarDeclare), identifier(identifier), is_const(is_const), expression(move(expression)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         EvalResult result;
         #pragma omp critical
         {
-            result = expression->Evaluate(symbol_table, func_table);
-            if (result == EvalResult("NULL")) { throw invalid_argument("Cannot assign NULL value to variable " + identifier); }
-            symbol_table.setVariable(identifier, result, true);
+            result = expression ? expression->Evaluate(symbol_table, func_table) : ops::zero(declared);
+            if (result.is_null()) { throw invalid_argument("Cannot assign NULL value to variable " + symbol_name(identifier)); }
+            if (checked != ValueType::Null && !ops::conform(result, checked)) { throw ops::type_mismatch(symbol_name(identifier), checked, result.type()); }
+            symbol_table.setVariable(slot, result);
         }
         return result;
     }
-private:
-    string identifier;
+    SymbolId identifier;
+    uint32_t slot = 0;
+    bool is_const;
+    // Type named in the declaration, Null without one or for types the interpreter cannot check
+    ValueType declared = ValueType::Null;
+    // Set by the type checker to the variable's declared type when the stored value is not proven to have it, or is
+    // an int to promote to double
+    ValueType checked = ValueType::Null;
     NodePtr expression;
 };
 
 class AssignmentNode : public Node {
 public:
-    AssignmentNode(string identifier, NodePtr expression) : identifier(identifier), expression(move(expression)) {type = "AssignmentNode";}
+    AssignmentNode(SymbolId identifier, NodePtr expression) : Node(NodeKind::Assignment), identifier(identifier), expression(move(expression)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         EvalResult result = expression->Evaluate(symbol_table, func_table);
-        if (result == EvalResult("NULL")) { throw invalid_argument("Cannot assign NULL value to variable " + identifier); }
-        symbol_table.setVariable(identifier, result, false);
+        if (result.is_null()) { throw invalid_argument("Cannot assign NULL value to variable " + symbol_name(identifier)); }
+        if (checked != ValueType::Null && !ops::conform(result, checked)) { throw ops::type_mismatch(symbol_name(identifier), checked, result.type()); }
+        symbol_table.setVariable(slot, result);
         return result;
     }
-private:
-    string identifier;
+    SymbolId identifier;
+    uint32_t slot = 0;
+    // As in VarDeclareNode
+    ValueType checked = ValueType::Null;
     NodePtr expression;
 };
 
 class WhileNode : public Node {
 public:
-    WhileNode(NodePtr condition, NodePtr block) : condition(move(condition)), block(move(block)) {type = "WhileNode";}
+    WhileNode(NodePtr condition, NodePtr block) : Node(NodeKind::While), condition(move(condition)), block(move(block)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        while (get<bool>(condition->Evaluate(symbol_table, func_table))) { block->Evaluate(symbol_table, func_table); }
-        return EvalResult("NULL");
+        Tiering* tiering = func_table.tiering;
+        if (tiering) {
+            if (const Chunk* chunk = compiled.load(memory_order_acquire)) { return tiering->execute(*chunk, symbol_table); }
+        }
+        while (condition->Test(symbol_table, func_table)) {
+            block->Evaluate(symbol_table, func_table);
+            if (symbol_table.completion != Completion::Normal) {
+                if (symbol_table.completion == Completion::Return || symbol_table.completion == Completion::TailCall) { break; }
+                Completion completion = symbol_table.completion;
+                symbol_table.completion = Completion::Normal;
+                if (completion == Completion::Break) { break; }
+            }
+            // Back-edge: once the loop is hot, its compiled chunk takes over from the next condition check
+            if (tiering) {
+                const Chunk* chunk = compiled.load(memory_order_acquire);
+                if (!chunk && back_edges.fetch_add(1, memory_order_relaxed) + 1 == tiering->threshold) {
+                    chunk = tiering->compile_loop(this);
+                    compiled.store(chunk, memory_order_release);
+                }
+                if (chunk) { return tiering->execute(*chunk, symbol_table); }
+            }
+        }
+        return EvalResult();
     }
-private:
     NodePtr condition, block;
+    // Source offset of the while keyword, to name the loop in tier-up statistics
+    uint32_t offset = 0;
+    mutable atomic<uint32_t> back_edges{ 0 };
+    mutable atomic<const Chunk*> compiled{ nullptr };
 };
 
 class IfNode : public Node {
 public:
-    IfNode(NodePtr condition, NodePtr block, NodePtr else_block) : condition(move(condition)), block(move(block)), else_block(move(else_block)) {type = "IfNode";}
+    IfNode(NodePtr condition, NodePtr block, NodePtr else_block) : Node(NodeKind::If), condition(move(condition)), block(move(block)), else_block(move(else_block)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        EvalResult result = condition->Evaluate(symbol_table, func_table);
-        if (get<bool>(result)) { return block->Evaluate(symbol_table, func_table); }
+        if (condition->Test(symbol_table, func_table)) { return block->Evaluate(symbol_table, func_table); }
         else { return else_block->Evaluate(symbol_table, func_table); }
     }
-private:
     NodePtr condition, block, else_block;
 };
 
 class FuncDeclareNode : public Node {
 public:
-    FuncDeclareNode(const string& func_name, const vector<string>& args, NodePtr block_node)
-        : func_name(func_name), args(args), block_node(move(block_node)) {type = "FuncDeclareNode";}
+    FuncDeclareNode(SymbolId func_name, ArenaSpan<SymbolId> args, ArenaSpan<ValueType> arg_types, ValueType return_type, NodePtr block_node)
+        : Node(NodeKind::FuncDeclare), func_name(func_name), args(args), arg_types(arg_types), return_type(return_type), block_node(move(block_node)) {}
     virtual EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        func_table.setFunction(func_name, args, block_node);
-        return EvalResult("NULL");
+        func_table.setFunction(func_name, args, arg_types, block_node, frame_size);
+        return EvalResult();
     }
-private:
-    string func_name;
-    vector<string> args;
+    SymbolId func_name;
+    uint32_t frame_size = 0;
+    ArenaSpan<SymbolId> args;
+    // Declared parameter types, empty when no parameter declares one; Null entries are unchecked
+    ArenaSpan<ValueType> arg_types;
+    ValueType return_type;
     NodePtr block_node;
 };
 
 class FuncCallNode : public Node {
 public:
-    FuncCallNode(const string& identifier, const vector<NodePtr>& args) : identifier(identifier), args(args) {type = "FuncCallNode";}
+    FuncCallNode(SymbolId identifier, NodeList args, const Builtin* builtin = nullptr) : Node(NodeKind::FuncCall), identifier(identifier), args(args), builtin(builtin) {}
     virtual EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        if (identifier == "print") { return make_shared<PrintNode>(args[0])->Evaluate(symbol_table, func_table); }
-        if (identifier == "read") { return make_shared<ReadNode>()->Evaluate(symbol_table, func_table); }
-        if (identifier == "callprogram") { return make_shared<CallProgramNode>(args[0], vector<NodePtr>(args.begin() + 1, args.end()))->Evaluate(symbol_table, func_table); }
-        FuncInfo func_info = func_table.getFunction(identifier);
-        if (func_info.args.size() != args.size()) { throw invalid_argument("Function " + identifier + " expects " + to_string(func_info.args.size()) + " arguments, but " + to_string(args.size()) + " were given"); }
-        SymbolTable new_symbol_table = SymbolTable();
-        for (size_t i = 0; i < func_info.args.size(); i++) { new_symbol_table.setVariable(func_info.args[i], args[i]->Evaluate(symbol_table, func_table), true); }
-        return func_info.block->Evaluate(new_symbol_table, func_table);
-    }
-private:
-    string identifier;
-    vector<NodePtr> args;
+        if (builtin) {
+            PooledFrame<EvalResult> values(args.size());
+            for (size_t i = 0; i < args.size(); i++) { values.items[i] = args[i]->Evaluate(symbol_table, func_table); }
+            return builtin->function(values.items, args.size());
+        }
+        const FuncInfo* func_info = &resolve(func_table);
+        check_arity(*func_info, args.size());
+        // Parameters occupy the first slots of the callee's frame, in order, and are evaluated straight into them
+        PooledFrame<Slot> frame(func_info->frame_size);
+        for (size_t i = 0; i < args.size(); i++) {
+            frame.items[i].value = args[i]->Evaluate(symbol_table, func_table);
+            frame.items[i].defined = true;
+        }
+        check_arguments(*func_info, frame.items);
+        SymbolTable new_symbol_table(frame.items);
+        while (true) {
+            EvalResult result = run_body(*func_info, new_symbol_table, func_table);
+            if (new_symbol_table.completion != Completion::TailCall) { return result; }
+            func_info = &enter_tail_call(new_symbol_table, frame, func_table);
+        }
+    }
+
+    // Runs a function body on its prepared frame, compiled once the tiered engine has seen enough calls to it
+    static EvalResult run_body(const FuncInfo& func_info, SymbolTable& symbol_table, FuncTable& func_table) {
+        EvalResult result;
+        if (run_native(func_info, symbol_table, result)) { return result; }
+        if (Tiering* tiering = func_table.tiering) {
+            const Chunk* chunk = func_info.chunk.load(memory_order_acquire);
+            if (!chunk && func_info.calls.fetch_add(1, memory_order_relaxed) + 1 == tiering->threshold) {
+                // Only the call that crosses the threshold compiles; calls already running keep walking the tree
+                chunk = tiering->compile_function(func_info);
+                func_info.chunk.store(chunk, memory_order_release);
+            }
+            if (chunk) { return tiering->execute(*chunk, symbol_table); }
+        }
+        func_info.block->Evaluate(symbol_table, func_table);
+        if (symbol_table.completion == Completion::Return) { return move(symbol_table.return_value); }
+        return EvalResult();
+    }
+
+    // Calls the function's native code, if the JIT has installed it and every argument is an int. Returns false when
+    // the interpreter has to make the call, which includes native code giving up half way: the JIT only compiles
+    // functions without side effects, so the interpreter can start the call over and report the error itself.
+    static bool run_native(const FuncInfo& func_info, const SymbolTable& symbol_table, EvalResult& result) {
+        NativeEntry native = func_info.native.load(memory_order_acquire);
+        if (!native) { return false; }
+        int args[MAX_NATIVE_ARGS];
+        for (size_t i = 0; i < func_info.args.size(); i++) {
+            const EvalResult& arg = symbol_table.getVariable(i, func_info.args[i]);
+            if (!arg.is_int()) { return false; }
+            args[i] = arg.int_unchecked();
+        }
+        int value;
+        switch (static_cast<NativeResult>(native(args, &value))) {
+            case NativeResult::Int: result = EvalResult(value); return true;
+            case NativeResult::Bool: result = EvalResult(value != 0); return true;
+            case NativeResult::Null: result = EvalResult(); return true;
+            default: return false;
+        }
+    }
+
+    // Parameters with a declared type only ever hold that type, which the type checker relies on; ints passed for a
+    // double are promoted
+    static void check_arguments(const FuncInfo& func_info, Slot* frame) {
+        for (size_t i = 0; i < func_info.arg_types.size(); i++) {
+            ValueType declared = func_info.arg_types[i];
+            if (declared != ValueType::Null && !ops::conform(frame[i].value, declared)) { throw ops::type_mismatch(symbol_name(func_info.args[i]), declared, frame[i].value.type()); }
+        }
+    }
+
+    void check_arity(const FuncInfo& func_info, size_t count) const {
+        if (func_info.args.size() != count) { throw invalid_argument("Function " + symbol_name(identifier) + " expects " + to_string(func_info.args.size()) + " arguments, but " + to_string(count) + " were given"); }
+    }
+
+    // Replaces the function that just finished with the call it left in symbol_table.tail_call, reusing its frame so
+    // a chain of tail calls runs in constant native stack. Returns the function to run next.
+    static const FuncInfo& enter_tail_call(SymbolTable& symbol_table, PooledFrame<Slot>& frame, FuncTable& func_table) {
+        const FuncCallNode* call = symbol_table.tail_call;
+        const FuncInfo& func_info = call->resolve(func_table);
+        call->check_arity(func_info, symbol_table.tail_args.size());
+        frame.reset(func_info.frame_size);
+        for (size_t i = 0; i < symbol_table.tail_args.size(); i++) { frame.items[i] = { move(symbol_table.tail_args[i]), true }; }
+        check_arguments(func_info, frame.items);
+        symbol_table.reenter(frame.items);
+        return func_info;
+    }
+
+    // Inline cache: (table version << 32 | function index) from the last lookup. Versions start at 1, so the
+    // initial 0 never matches; a stale stamp just means one more hash lookup.
+    const FuncInfo& resolve(const FuncTable& func_table) const {
+        uint64_t cached = cache.load(memory_order_relaxed);
+        uint32_t version = func_table.version();
+        if ((cached >> 32) == version) { return func_table.at(static_cast<uint32_t>(cached)); }
+        uint32_t index = func_table.indexOf(identifier);
+        cache.store((static_cast<uint64_t>(version) << 32) | index, memory_order_relaxed);
+        return func_table.at(index);
+    }
+    SymbolId identifier;
+    NodeList args;
+    // Set by the parser when identifier names a registered native function
+    const Builtin* builtin;
+    mutable atomic<uint64_t> cache{ 0 };
 };
 
 class ReturnNode : public Node {
 public:
-    ReturnNode(NodePtr return_node) : return_node(move(return_node)) {type = "ReturnNode";}
+    ReturnNode(NodePtr return_node) : Node(NodeKind::Return), return_node(move(return_node)) {}
     virtual EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        return return_node->Evaluate(symbol_table, func_table);
+        if (tail_call) {
+            // Only the arguments are evaluated here; the caller's FuncCallNode makes the call on this frame
+            auto call = static_cast<const FuncCallNode*>(return_node);
+            for (const auto& arg : call->args) { symbol_table.tail_args.push_back(arg->Evaluate(symbol_table, func_table)); }
+            symbol_table.tail_call = call;
+            symbol_table.completion = Completion::TailCall;
+            return EvalResult();
+        }
+        symbol_table.return_value = return_node->Evaluate(symbol_table, func_table);
+        symbol_table.completion = Completion::Return;
+        return symbol_table.return_value;
     }
-private:
     NodePtr return_node;
+    // Set by the resolver when return_node is a call to a user function made from a function body
+    bool tail_call = false;
 };
 
 class BreakNode : public Node {
 public:
-    BreakNode() {type = "BreakNode";}
+    BreakNode() : Node(NodeKind::Break) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        throw runtime_error("Break statement");
+        symbol_table.completion = Completion::Break;
+        return EvalResult();
     }
 };
 
 class ContinueNode : public Node {
 public:
-    ContinueNode() {type = "ContinueNode";}
+    ContinueNode() : Node(NodeKind::Continue) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        throw runtime_error("Continue statement");
+        symbol_table.completion = Completion::Continue;
+        return EvalResult();
     }
 };
 
 class BlockNode : public Node {
 public:
-    BlockNode() {type = "BlockNode";}
+    BlockNode(NodeList statements) : Node(NodeKind::Block), statements(statements) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        bool should_break = false;
         for (const auto& statement : statements) {
-            if (should_break) { break; }
-            try { statement->Evaluate(symbol_table, func_table); } 
-            catch (const runtime_error& e) {
-                if (string(e.what()) == "Break statement") { should_break = true; } 
-                else if (string(e.what()) == "Continue statement") { continue; } 
-                else { throw; }
-            }
+            statement->Evaluate(symbol_table, func_table);
+            if (symbol_table.completion != Completion::Normal) { break; }
         }
-        return EvalResult("NULL");
+        return EvalResult();
     }
+    NodeList statements;
 };
 
 class ProgramNode : public Node {
 public:
-    ProgramNode(NodePtr setup_block, NodePtr main_block) : setup_block(move(setup_block)), main_block(move(main_block)) {type = "ProgramNode";}
+    ProgramNode(NodePtr setup_block, NodePtr main_block) : Node(NodeKind::Program), setup_block(move(setup_block)), main_block(move(main_block)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
+        // A break, continue or return outside of any loop or function just ends the current pass over the block
+        symbol_table.resize(frame_size);
         setup_block->Evaluate(symbol_table, func_table);
-        while (true) { main_block->Evaluate(symbol_table, func_table); }
+        symbol_table.completion = Completion::Normal;
+        while (true) {
+            main_block->Evaluate(symbol_table, func_table);
+            symbol_table.completion = Completion::Normal;
+        }
         return EvalResult(0);
     }
-private:
     NodePtr setup_block, main_block;
+    uint32_t frame_size = 0;
 };
 
 class EnumNode : public Node {
 public:
-    EnumNode(string name, vector<string> values) : name(name), values(values) { type = "EnumNode"; }
+    EnumNode(SymbolId name, vector<SymbolId> values) : Node(NodeKind::Enum), name(name), values(values) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         symbol_table.setEnum(name, values);
-        return EvalResult("NULL");
+        return EvalResult();
     }
-private:
-    string name;
-    vector<string> values;
+    SymbolId name;
+    vector<SymbolId> values;
 };
 
 class EnumValNode : public Node {
 public:
-    EnumValNode(string enumName, string valueName) : enumName(enumName), valueName(valueName) { type = "EnumValNode"; }
+    EnumValNode(SymbolId enumName, SymbolId valueName) : Node(NodeKind::EnumVal), enumName(enumName), valueName(valueName) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         int value = symbol_table.getEnumValue(enumName, valueName);
         return EvalResult(value);
     }
-private:
-    string enumName;
-    string valueName;
+    SymbolId enumName;
+    SymbolId valueName;
 };
 
 class StructNode : public Node {
 public:
-    StructNode(const string& name, const vector<pair<string, string>>& field_list) : struct_name(name), fields(field_list) { type = "StructNode"; }
+    StructNode(SymbolId name, const vector<pair<SymbolId, SymbolId>>& field_list) : Node(NodeKind::Struct), struct_name(name), fields(field_list) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         symbol_table.define_struct(struct_name, fields);
-        return EvalResult("NULL");
+        return EvalResult();
     }
-private:
-    string struct_name;
-    vector<pair<string, string>> fields;
+    SymbolId struct_name;
+    vector<pair<SymbolId, SymbolId>> fields;
 };
 
 class StructFieldNode : public Node {
 public:
-    StructFieldNode(const string& sname, const string& fname) : struct_instance_name(sname), field_name(fname) { type = "StructFieldNode"; }
+    StructFieldNode(SymbolId sname, SymbolId fname) : Node(NodeKind::StructField), struct_instance_name(sname), field_name(fname) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         auto struct_instance = symbol_table.get_struct_instance(struct_instance_name);
         if (!struct_instance) {
-            throw runtime_error("Struct instance '" + struct_instance_name + "' not found.");
+            throw runtime_error("Struct instance '" + symbol_name(struct_instance_name) + "' not found.");
         }
         auto field_iter = struct_instance->find(field_name);
         if (field_iter == struct_instance->end()) {
-            throw runtime_error("Field '" + field_name + "' not found in struct instance '" + struct_instance_name + "'.");
+            throw runtime_error("Field '" + symbol_name(field_name) + "' not found in struct instance '" + symbol_name(struct_instance_name) + "'.");
         }
         return field_iter->second;
     }
-private:
-    string struct_instance_name;
-    string field_name;
+    SymbolId struct_instance_name;
+    SymbolId field_name;
 };
 
 class ArrayNode : public Node {
 public:
-    ArrayNode(const vector<NodePtr>& nodes) : nodes(nodes) { type = "ArrayNode"; }
+    ArrayNode(NodeList nodes) : Node(NodeKind::Array), nodes(nodes) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
+        vector<EvalResult> values(nodes.size());
         #pragma omp parallel for
         for (size_t i = 0; i < nodes.size(); ++i) {
-            nodes[i]->Evaluate(symbol_table, func_table);
+            values[i] = nodes[i]->Evaluate(symbol_table, func_table);
         }
-        return EvalResult("NULL");
+        return ops::build_array(values);
     }
-private:
-    vector<NodePtr> nodes;
+    NodeList nodes;
 };
 
 class ArrayAccessNode : public Node {
 public:
-    ArrayAccessNode(string identifier, NodePtr index) : identifier(identifier), index(move(index)) { type = "ArrayAccessNode"; }
+    ArrayAccessNode(SymbolId identifier, NodePtr index) : Node(NodeKind::ArrayAccess), identifier(identifier), index(move(index)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
-        EvalResult array = symbol_table.getVariable(identifier);
+        const EvalResult& array = symbol_table.getVariable(slot, identifier);
         EvalResult index_value = index->Evaluate(symbol_table, func_table);
-        if (holds_alternative<vector<int>>(array)) { return get<vector<int>>(array)[get<int>(index_value)]; }
-        if (holds_alternative<vector<double>>(array)) { return get<vector<double>>(array)[get<int>(index_value)]; }
-        if (holds_alternative<vector<bool>>(array)) { return get<vector<bool>>(array)[get<int>(index_value)]; }
-        if (holds_alternative<vector<string>>(array)) { return get<vector<string>>(array)[get<int>(index_value)]; }
-        throw runtime_error("Unsupported array type.");
-    }
-private:
-    string identifier;
+        if (!array.is_array()) { throw runtime_error("Unsupported array type."); }
+        return array.element(index_value.as_int());
+    }
+    SymbolId identifier;
+    uint32_t slot = 0;
     NodePtr index;
 };
 
 class ThreadLoopNode : public Node {
 public:
-    ThreadLoopNode(const string& name, vector<string> args, NodePtr block) : name(name), args(move(args)), block(move(block)) { type = "ThreadLoopNode"; }
+    ThreadLoopNode(SymbolId name, ArenaSpan<SymbolId> args, NodePtr block) : Node(NodeKind::ThreadLoop), name(name), args(move(args)), block(move(block)) {}
     EvalResult Evaluate(SymbolTable& symbol_table, FuncTable& func_table) const override {
         thread t([&](){
-            while (true) { block->Evaluate(symbol_table, func_table); }
+            // The block reads and writes the caller's variables, but its break, continue and return stay on this thread
+            SymbolTable thread_table(&symbol_table);
+            while (true) {
+                block->Evaluate(thread_table, func_table);
+                Completion completion = thread_table.completion;
+                thread_table.completion = Completion::Normal;
+                if (completion == Completion::Break || completion == Completion::Return) { break; }
+            }
         });
         t.detach();
-        return EvalResult("NULL");
+        return EvalResult();
     }
-private:
-    string name;
-    vector<string> args;
+    SymbolId name;
+    ArenaSpan<SymbolId> args;
     NodePtr block;
 };
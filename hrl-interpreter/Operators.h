@@ -0,0 +1,216 @@
+#pragma once
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Value.h"
+using namespace std;
+
+// Binary and unary operators, resolved from their tokens by the parser
+enum class BinOp : unsigned char { Add, Sub, Mul, Div, Mod, Eq, Ne, Lt, Le, Gt, Ge, And, Or, Concat };
+enum class UnOp : unsigned char { Plus, Neg, Not };
+
+// Operator semantics shared by the tree-walker, the bytecode VM and programs compiled by hrlc
+namespace ops {
+
+inline int to_int(const Value& value) {
+    switch (value.type()) {
+        case ValueType::Int: return value.int_unchecked();
+        case ValueType::Double: return value.double_unchecked();
+        case ValueType::Bool: return value.bool_unchecked();
+        default: throw invalid_argument("Invalid binary operation");
+    }
+}
+
+inline double to_double(const Value& value) {
+    switch (value.type()) {
+        case ValueType::Int: return value.int_unchecked();
+        case ValueType::Double: return value.double_unchecked();
+        case ValueType::Bool: return value.bool_unchecked();
+        default: throw invalid_argument("Invalid binary operation");
+    }
+}
+
+inline string to_text(const Value& value) {
+    switch (value.type()) {
+        case ValueType::Null: return "NULL";
+        case ValueType::Int: return to_string(value.int_unchecked());
+        case ValueType::Double: return to_string(value.double_unchecked());
+        case ValueType::String: return value.as_string();
+        case ValueType::Bool: return value.bool_unchecked() ? "1" : "0";
+        default: return "";
+    }
+}
+
+inline bool is_arithmetic(BinOp op) { return op <= BinOp::Mod; }
+
+// Arithmetic gives a double when either operand is one and an int for ints and bools; Null when that depends on
+// operand types that are not known. Concat gives a string and the rest a bool, whatever the operands.
+inline ValueType result_type(BinOp op, ValueType left, ValueType right) {
+    if (op == BinOp::Concat) { return ValueType::String; }
+    if (!is_arithmetic(op)) { return ValueType::Bool; }
+    if (left == ValueType::Double || right == ValueType::Double) { return ValueType::Double; }
+    bool left_int = left == ValueType::Int || left == ValueType::Bool;
+    bool right_int = right == ValueType::Int || right == ValueType::Bool;
+    return left_int && right_int ? ValueType::Int : ValueType::Null;
+}
+
+// Arithmetic and comparisons on unboxed operands, shared by evaluate and the paths the type checker enables
+inline int arithmetic(BinOp op, int left, int right) {
+    switch (op) {
+        case BinOp::Add: return left + right;
+        case BinOp::Sub: return left - right;
+        case BinOp::Mul: return left * right;
+        case BinOp::Div:
+            if (right == 0) { throw invalid_argument("Division by zero"); }
+            return left / right;
+        case BinOp::Mod:
+            if (right == 0) { throw invalid_argument("Division by zero"); }
+            return left % right;
+        default: throw invalid_argument("Invalid binary operation");
+    }
+}
+
+// Division and modulo by zero fail as they do on ints instead of producing an infinity or NaN
+inline double arithmetic(BinOp op, double left, double right) {
+    switch (op) {
+        case BinOp::Add: return left + right;
+        case BinOp::Sub: return left - right;
+        case BinOp::Mul: return left * right;
+        case BinOp::Div:
+            if (right == 0) { throw invalid_argument("Division by zero"); }
+            return left / right;
+        case BinOp::Mod:
+            if (right == 0) { throw invalid_argument("Division by zero"); }
+            return fmod(left, right);
+        default: throw invalid_argument("Invalid binary operation");
+    }
+}
+
+template <typename T>
+bool compare(BinOp op, T left, T right) {
+    switch (op) {
+        case BinOp::Eq: return left == right;
+        case BinOp::Ne: return left != right;
+        case BinOp::Lt: return left < right;
+        case BinOp::Le: return left <= right;
+        case BinOp::Gt: return left > right;
+        case BinOp::Ge: return left >= right;
+        case BinOp::And: return left != 0 && right != 0;
+        case BinOp::Or: return left != 0 || right != 0;
+        default: throw invalid_argument("Invalid binary operation");
+    }
+}
+
+template <typename T>
+Value evaluate(BinOp op, const T& left, const T& right) {
+    if constexpr (is_same_v<T, string>) {
+        switch (op) {
+            case BinOp::Concat: return Value(left + right);
+            case BinOp::Eq: return Value(left == right);
+            case BinOp::Ne: return Value(left != right);
+            case BinOp::Lt: return Value(left < right);
+            case BinOp::Le: return Value(left <= right);
+            case BinOp::Gt: return Value(left > right);
+            case BinOp::Ge: return Value(left >= right);
+            default: throw invalid_argument("Invalid operation on string type");
+        }
+    }
+    else if constexpr (is_same_v<T, int>) {
+        if (is_arithmetic(op)) { return Value(arithmetic(op, left, right)); }
+        if (op == BinOp::Concat) { return Value(to_string(left) + to_string(right)); }
+        return Value(compare(op, left, right));
+    }
+    else if constexpr (is_same_v<T, double>) {
+        if (is_arithmetic(op)) { return Value(arithmetic(op, left, right)); }
+        if (op == BinOp::Concat) { return Value(to_text(Value(left)) + to_text(Value(right))); }
+        return Value(compare(op, left, right));
+    }
+    else {
+        // bool: arithmetic and comparisons work on 0 and 1
+        if (op == BinOp::Concat) { return Value(to_text(Value(left)) + to_text(Value(right))); }
+        if (op == BinOp::And) { return Value(left != 0 && right != 0); }
+        if (op == BinOp::Or) { return Value(left != 0 || right != 0); }
+        return evaluate(op, static_cast<int>(left), static_cast<int>(right));
+    }
+}
+
+// Operands of the same scalar type go straight to their specialised evaluator; anything else is converted by the
+// generic path, which promotes both operands to double when either is one
+inline Value apply(BinOp op, const Value& left_value, const Value& right_value) {
+    if (left_value.type() == right_value.type()) {
+        switch (left_value.type()) {
+            case ValueType::Int: return evaluate(op, left_value.int_unchecked(), right_value.int_unchecked());
+            case ValueType::String: return evaluate(op, left_value.as_string(), right_value.as_string());
+            case ValueType::Double: return evaluate(op, left_value.double_unchecked(), right_value.double_unchecked());
+            case ValueType::Bool: return evaluate(op, left_value.bool_unchecked(), right_value.bool_unchecked());
+            default: break;
+        }
+    }
+    if (op == BinOp::Concat) { return Value(to_text(left_value) + to_text(right_value)); }
+    if (left_value.is_string() || right_value.is_string()) { throw invalid_argument("Unsupported operation on string type"); }
+    if (left_value.is_null() || right_value.is_null()) { throw invalid_argument("Unsupported operation on NULL value"); }
+    if (left_value.is_double() || right_value.is_double()) { return evaluate(op, to_double(left_value), to_double(right_value)); }
+    if (op == BinOp::And) { return Value(to_int(left_value) != 0 && to_int(right_value) != 0); }
+    if (op == BinOp::Or) { return Value(to_int(left_value) != 0 || to_int(right_value) != 0); }
+    return evaluate(op, to_int(left_value), to_int(right_value));
+}
+
+inline Value unary(UnOp op, const Value& child_value) {
+    switch (op) {
+        case UnOp::Plus: return child_value.is_double() ? child_value : Value(child_value.as_int());
+        case UnOp::Neg: return child_value.is_double() ? Value(-child_value.double_unchecked()) : Value(-child_value.as_int());
+        case UnOp::Not: return !child_value.as_bool();
+    }
+    throw invalid_argument("Invalid unary operation");
+}
+
+// Default of a declaration without an initializer: the zero of its declared type, or 0 when it has none
+inline Value zero(ValueType type) {
+    switch (type) {
+        case ValueType::Double: return Value(0.0);
+        case ValueType::Bool: return Value(false);
+        case ValueType::String: return Value(string());
+        default: return Value(0);
+    }
+}
+
+// Fits a value stored into a variable or passed to a parameter declared with the given type, promoting an int
+// to double; false when the value has another type
+inline bool conform(Value& value, ValueType declared) {
+    if (value.type() == declared) { return true; }
+    if (declared != ValueType::Double || !value.is_int()) { return false; }
+    value = Value(static_cast<double>(value.int_unchecked()));
+    return true;
+}
+
+// A value stored into a variable or passed to a parameter declared with another type
+inline invalid_argument type_mismatch(const string& name, ValueType declared, ValueType actual) {
+    return invalid_argument("Type mismatch: " + name + " is declared " + valueTypeName(declared) + ", got " + valueTypeName(actual));
+}
+
+template <typename T, typename Getter>
+vector<T> collect(const vector<Value>& values, Getter getter) {
+    vector<T> items;
+    items.reserve(values.size());
+    for (const Value& value : values) { items.push_back((value.*getter)()); }
+    return items;
+}
+
+// Array literals are homogeneous; an empty literal is an empty int array
+inline Value build_array(const vector<Value>& values) {
+    ValueType type = values.empty() ? ValueType::Int : values[0].type();
+    for (const Value& value : values) {
+        if (value.type() != type) { throw invalid_argument("Array elements must all have the same type"); }
+    }
+    switch (type) {
+        case ValueType::Int: return Value(collect<int>(values, &Value::as_int));
+        case ValueType::Double: return Value(collect<double>(values, &Value::as_double));
+        case ValueType::Bool: return Value(collect<bool>(values, &Value::as_bool));
+        case ValueType::String: return Value(collect<string>(values, &Value::as_string));
+        default: throw invalid_argument(string("Arrays of ") + valueTypeName(type) + " are not supported");
+    }
+}
+
+}
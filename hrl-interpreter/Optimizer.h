@@ -0,0 +1,224 @@
+#pragma once
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+#include "Node.h"
+using namespace std;
+
+// AST rewrite pass run once after parsing. It folds operations on literals, replaces reads of `const` variables
+// with their literal value and turns `Enum::Value` accesses into integer literals. A rewrite only happens where
+// the tree-walker is guaranteed to produce the same value, so anything that could fail at run time is left alone.
+class Optimizer {
+private:
+    // Variables and enums visible to one symbol table: the global one (setup, main, threadloops) or a function's
+    struct Scope {
+        unordered_map<SymbolId, int> writes;
+        unordered_map<SymbolId, int> enum_declarations;
+        unordered_map<SymbolId, NodePtr> constants;
+        unordered_map<SymbolId, unordered_map<SymbolId, int>> enums;
+    };
+
+    Arena& arena;
+    vector<Scope> scopes;
+    int conditional_depth = 0;
+
+    static bool is_literal(NodePtr node) {
+        return node->kind == NodeKind::IntVal || node->kind == NodeKind::DoubleVal || node->kind == NodeKind::StringVal;
+    }
+
+    static EvalResult literal_value(NodePtr node) {
+        if (node->kind == NodeKind::IntVal) { return EvalResult(static_cast<IntValNode*>(node)->value); }
+        if (node->kind == NodeKind::DoubleVal) { return EvalResult(static_cast<DoubleValNode*>(node)->value); }
+        return EvalResult(static_cast<StringValNode*>(node)->value);
+    }
+
+    NodePtr make_literal(const EvalResult& value) {
+        if (value.is_int()) { return arena.make<IntValNode>(value.as_int()); }
+        if (value.is_double()) { return arena.make<DoubleValNode>(value.as_double()); }
+        if (value.is_string()) { return arena.make<StringValNode>(value.as_string()); }
+        return nullptr;
+    }
+
+    // Counts every declaration and assignment in the scope; function bodies are separate scopes and are skipped
+    void collect_writes(NodePtr node, Scope& scope) {
+        if (!node) { return; }
+        switch (node->kind) {
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                ++scope.writes[declare->identifier];
+                if (declare->is_const) { scope.constants.emplace(declare->identifier, nullptr); }
+                break;
+            }
+            case NodeKind::Assignment: ++scope.writes[static_cast<AssignmentNode*>(node)->identifier]; break;
+            case NodeKind::Enum: ++scope.enum_declarations[static_cast<EnumNode*>(node)->name]; break;
+            case NodeKind::While: collect_writes(static_cast<WhileNode*>(node)->block, scope); break;
+            case NodeKind::If:
+                collect_writes(static_cast<IfNode*>(node)->block, scope);
+                collect_writes(static_cast<IfNode*>(node)->else_block, scope);
+                break;
+            case NodeKind::Block:
+                for (NodePtr statement : static_cast<BlockNode*>(node)->statements) { collect_writes(statement, scope); }
+                break;
+            case NodeKind::Program:
+                collect_writes(static_cast<ProgramNode*>(node)->setup_block, scope);
+                collect_writes(static_cast<ProgramNode*>(node)->main_block, scope);
+                break;
+            case NodeKind::ThreadLoop: collect_writes(static_cast<ThreadLoopNode*>(node)->block, scope); break;
+            default: break;
+        }
+    }
+
+    // A constant is a name declared `const` once and never written otherwise (parameters count as writes)
+    void begin_scope(NodePtr root, ArenaSpan<SymbolId> parameters = {}) {
+        scopes.emplace_back();
+        Scope& scope = scopes.back();
+        for (SymbolId parameter : parameters) { ++scope.writes[parameter]; }
+        collect_writes(root, scope);
+        for (auto it = scope.constants.begin(); it != scope.constants.end();) {
+            if (scope.writes[it->first] != 1) { it = scope.constants.erase(it); }
+            else { ++it; }
+        }
+    }
+
+    NodePtr fold_binop(BinOpNode* binop) {
+        binop->left = optimize(binop->left);
+        binop->right = optimize(binop->right);
+        if (!is_literal(binop->left) || !is_literal(binop->right)) { return binop; }
+        try {
+            NodePtr folded = make_literal(ops::apply(binop->op, literal_value(binop->left), literal_value(binop->right)));
+            return folded ? folded : binop;
+        }
+        catch (const invalid_argument&) { return binop; }
+    }
+
+    void optimize_list(NodeList nodes) {
+        for (NodePtr& node : nodes) { node = optimize(node); }
+    }
+
+public:
+    Optimizer(Arena& arena) : arena(arena) {}
+
+    NodePtr run(NodePtr root) {
+        scopes.clear();
+        conditional_depth = 0;
+        begin_scope(root);
+        root = optimize(root);
+        scopes.pop_back();
+        return root;
+    }
+
+    // Optimizes the subtree in place and returns the node that should replace it
+    NodePtr optimize(NodePtr node) {
+        if (!node) { return node; }
+        // Nested function declarations push scopes, so this reference is only used before recursing
+        Scope& scope = scopes.back();
+        switch (node->kind) {
+            case NodeKind::BinOp: return fold_binop(static_cast<BinOpNode*>(node));
+            case NodeKind::UnOp: {
+                auto unop = static_cast<UnOpNode*>(node);
+                unop->child = optimize(unop->child);
+                return node;
+            }
+            case NodeKind::Var: {
+                auto it = scope.constants.find(static_cast<VarNode*>(node)->identifier);
+                if (it != scope.constants.end() && it->second) { return make_literal(literal_value(it->second)); }
+                return node;
+            }
+            case NodeKind::EnumVal: {
+                auto access = static_cast<EnumValNode*>(node);
+                auto it = scope.enums.find(access->enumName);
+                if (it == scope.enums.end()) { return node; }
+                auto value = it->second.find(access->valueName);
+                if (value == it->second.end()) { return node; }
+                return arena.make<IntValNode>(value->second);
+            }
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                declare->expression = optimize(declare->expression);
+                auto& constants = scopes.back().constants;
+                auto it = constants.find(declare->identifier);
+                // Only a declaration that always runs may stand in for later reads
+                if (it != constants.end() && conditional_depth == 0 && declare->expression && is_literal(declare->expression)) {
+                    it->second = declare->expression;
+                }
+                return node;
+            }
+            case NodeKind::Assignment: {
+                auto assignment = static_cast<AssignmentNode*>(node);
+                assignment->expression = optimize(assignment->expression);
+                return node;
+            }
+            case NodeKind::While: {
+                auto loop = static_cast<WhileNode*>(node);
+                loop->condition = optimize(loop->condition);
+                ++conditional_depth;
+                loop->block = optimize(loop->block);
+                --conditional_depth;
+                return node;
+            }
+            case NodeKind::If: {
+                auto branch = static_cast<IfNode*>(node);
+                branch->condition = optimize(branch->condition);
+                ++conditional_depth;
+                branch->block = optimize(branch->block);
+                branch->else_block = optimize(branch->else_block);
+                --conditional_depth;
+                return node;
+            }
+            case NodeKind::FuncDeclare: {
+                auto function = static_cast<FuncDeclareNode*>(node);
+                int outer_depth = conditional_depth;
+                conditional_depth = 0;
+                begin_scope(function->block_node, function->args);
+                function->block_node = optimize(function->block_node);
+                scopes.pop_back();
+                conditional_depth = outer_depth;
+                return node;
+            }
+            case NodeKind::FuncCall:
+                optimize_list(static_cast<FuncCallNode*>(node)->args);
+                return node;
+            case NodeKind::Return: {
+                auto ret = static_cast<ReturnNode*>(node);
+                ret->return_node = optimize(ret->return_node);
+                return node;
+            }
+            case NodeKind::Block:
+                optimize_list(static_cast<BlockNode*>(node)->statements);
+                return node;
+            case NodeKind::Program: {
+                auto program = static_cast<ProgramNode*>(node);
+                program->setup_block = optimize(program->setup_block);
+                program->main_block = optimize(program->main_block);
+                return node;
+            }
+            case NodeKind::Enum: {
+                auto declaration = static_cast<EnumNode*>(node);
+                if (conditional_depth == 0 && scope.enum_declarations[declaration->name] == 1) {
+                    // Same numbering as SymbolTable::setEnum
+                    auto& values = scope.enums[declaration->name];
+                    for (size_t i = 0; i < declaration->values.size(); ++i) { values[declaration->values[i]] = i; }
+                }
+                return node;
+            }
+            case NodeKind::Array:
+                optimize_list(static_cast<ArrayNode*>(node)->nodes);
+                return node;
+            case NodeKind::ArrayAccess: {
+                auto access = static_cast<ArrayAccessNode*>(node);
+                access->index = optimize(access->index);
+                return node;
+            }
+            case NodeKind::ThreadLoop: {
+                auto loop = static_cast<ThreadLoopNode*>(node);
+                ++conditional_depth;
+                loop->block = optimize(loop->block);
+                --conditional_depth;
+                return node;
+            }
+            default:
+                return node;
+        }
+    }
+};
@@ -1,508 +1,610 @@
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <exception>
+#include <thread>
 #include "Tokenizer.h"
 #include "Node.h"
+#include "CostModel.h"
+#include "Optimizer.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
 
 using namespace std;
 
+struct ParsedScript {
+    unique_ptr<Arena> arena;
+    NodePtr root = nullptr;
+};
+
+// Each Parser owns its token buffer and cursor, so separate instances can parse different scripts concurrently.
+// Nodes are allocated in the arena passed to the constructor, which must outlive the returned tree.
 class Parser {
 private:
-    static Token current_token;
+    Arena& arena;
+    TokenBuffer tokens;
+    size_t cursor = 0;
+    bool parallel_lexing = true;
+
+    TokenType current() const { return tokens.kinds[cursor]; }
+    TokenType peek(size_t ahead = 1) const { return tokens.kinds[min(cursor + ahead, tokens.size() - 1)]; }
+    string_view text() const { return tokens.text(cursor); }
+    const NumberLiteral& number() const { return tokens.numbers[tokens.literals[cursor]]; }
+    SymbolId symbol() const { return tokens.literals[cursor]; }
+    uint32_t offset() const { return tokens.offsets[cursor]; }
+    void advance() { if (cursor + 1 < tokens.size()) { cursor++; } }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) { return arena.make<T>(forward<Args>(args)...); }
 
 public:
-    static Tokenizer tokenizer;
-
-    shared_ptr<Node> parse_program() {
-        if (current_token.type != "SETUP") { throw invalid_argument("Program must start with 'setup'"); }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> setup_block = parse_block();
-        if (current_token.type != "MAIN") { throw invalid_argument("Missing main block after setup"); }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> main_block = parse_block();
-        return make_shared<ProgramNode>(setup_block, main_block);
+    Parser(Arena& arena) : arena(arena) {}
+
+    NodePtr parse_program() {
+        if (current() != TokenType::SETUP) { throw invalid_argument("Program must start with 'setup'"); }
+        advance();
+        NodePtr setup_block = parse_block();
+        if (current() != TokenType::MAIN) { throw invalid_argument("Missing main block after setup"); }
+        advance();
+        NodePtr main_block = parse_block();
+        return make<ProgramNode>(setup_block, main_block);
     }
 
-    shared_ptr<Node> parse_block() {
-        shared_ptr<Node> block_node = make_shared<BlockNode>();
-        if (current_token.type != "LBRACE") { throw invalid_argument("Expected '{' at start of block"); }
-        current_token = tokenizer.selectNext();
-        while (current_token.type != "EOF" && current_token.type != "RBRACE" && current_token.type != "ELSE") {
-            block_node->add_statement(parse_statement());
-        }
-        if (current_token.type != "RBRACE") { throw invalid_argument("Expected '}' at end of block"); }
-        current_token = tokenizer.selectNext();
-        return block_node;
+    NodePtr parse_block() {
+        if (current() != TokenType::LBRACE) { throw invalid_argument("Expected '{' at start of block"); }
+        advance();
+        vector<NodePtr> statements;
+        while (current() != TokenType::END_OF_FILE && current() != TokenType::RBRACE && current() != TokenType::ELSE) {
+            statements.push_back(parse_statement());
+        }
+        if (current() != TokenType::RBRACE) { throw invalid_argument("Expected '}' at end of block"); }
+        advance();
+        return make<BlockNode>(arena.copy(statements));
     }
 
-    shared_ptr<Node> parse_statement() {
-        if (current_token.type == "EOF") {
-            return make_shared<NoOpNode>();
-        } else if (current_token.type == "NEWLINE" || current_token.type == "RBRACE" || current_token.type == "ELSE") {
-            current_token = tokenizer.selectNext();
-            return make_shared<NoOpNode>();
-        } else if (current_token.type == "CONST") {
+    NodePtr parse_statement() {
+        if (current() == TokenType::END_OF_FILE) {
+            return make<NoOpNode>();
+        } else if (current() == TokenType::RBRACE || current() == TokenType::ELSE) {
+            advance();
+            return make<NoOpNode>();
+        } else if (current() == TokenType::CONST) {
             return parse_const_declaration();
-        } else if (current_token.type == "IF") {
+        } else if (current() == TokenType::IF) {
             return parse_if_statement();
-        } else if (current_token.type == "WHILE") {
+        } else if (current() == TokenType::WHILE) {
             return parse_while_statement();
-        } else if (current_token.type == "RETURN") {
+        } else if (current() == TokenType::RETURN) {
             return parse_return_statement();
-        } else if (current_token.type == "BREAK") {
+        } else if (current() == TokenType::BREAK) {
             return parse_break_statement();
-        } else if (current_token.type == "CONTINUE") {
+        } else if (current() == TokenType::CONTINUE) {
             return parse_continue_statement();
-        } else if (current_token.type == "FUNCTION") {
+        } else if (current() == TokenType::FUNCTION) {
             return parse_function_declaration();
-        } else if (current_token.type == "ENUM") {
+        } else if (current() == TokenType::ENUM) {
             return parse_enum_declaration();
-        } else if (current_token.type == "STRUCT") {
+        } else if (current() == TokenType::STRUCT) {
             return parse_struct_declaration();
-        } else if (current_token.type == "THREADLOOP") {
+        } else if (current() == TokenType::THREADLOOP) {
             return parse_threadloop_statement();
         } else {
             return parse_vardec_assignment_funccall();
         }
     }
 
-    shared_ptr<Node> parse_threadloop_statement() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "IDENTIFIER") { throw invalid_argument("Expected identifier after 'threadloop'"); }
-        string threadloop_name = current_token.valueString;
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "LPAREN") { throw invalid_argument("Expected '(' after threadloop name"); }
-        current_token = tokenizer.selectNext();
-        vector<string> args;
-        while (current_token.type != "RPAREN") {
-            if (current_token.type != "IDENTIFIER") { throw invalid_argument("Expected identifier in threadloop arguments"); }
-            args.push_back(current_token.valueString);
-            current_token = tokenizer.selectNext();
-            if (current_token.type == "RPAREN") { break; }
-            if (current_token.type != "COMMA") { throw invalid_argument("Expected ',' after threadloop argument"); }
-            current_token = tokenizer.selectNext();
-        }
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "LBRACE") { throw invalid_argument("Expected '{' after threadloop arguments"); }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> block_node = parse_block();
-        if (current_token.type != "RBRACE") { throw invalid_argument("Expected '}' after threadloop block"); }
-        current_token = tokenizer.selectNext();
-        return make_shared<ThreadLoopNode>(threadloop_name, args, block_node);
+    NodePtr parse_threadloop_statement() {
+        advance();
+        if (current() != TokenType::IDENTIFIER) { throw invalid_argument("Expected identifier after 'threadloop'"); }
+        SymbolId threadloop_name = symbol();
+        advance();
+        if (current() != TokenType::LPAREN) { throw invalid_argument("Expected '(' after threadloop name"); }
+        advance();
+        vector<SymbolId> args;
+        while (current() != TokenType::RPAREN) {
+            if (current() != TokenType::IDENTIFIER) { throw invalid_argument("Expected identifier in threadloop arguments"); }
+            args.push_back(symbol());
+            advance();
+            if (current() == TokenType::RPAREN) { break; }
+            if (current() != TokenType::COMMA) { throw invalid_argument("Expected ',' after threadloop argument"); }
+            advance();
+        }
+        advance();
+        if (current() != TokenType::LBRACE) { throw invalid_argument("Expected '{' after threadloop arguments"); }
+        advance();
+        NodePtr block_node = parse_block();
+        if (current() != TokenType::RBRACE) { throw invalid_argument("Expected '}' after threadloop block"); }
+        advance();
+        return make<ThreadLoopNode>(threadloop_name, arena.copy(args), block_node);
     }
 
-    shared_ptr<Node> parse_enum_declaration() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "IDENTIFIER") {
+    NodePtr parse_enum_declaration() {
+        advance();
+        if (current() != TokenType::IDENTIFIER) {
             throw invalid_argument("Expected identifier after 'enum'");
         }
-        string enum_name = current_token.valueString;
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "LBRACE") {
+        SymbolId enum_name = symbol();
+        advance();
+        if (current() != TokenType::LBRACE) {
             throw invalid_argument("Expected '{' after enum name");
         }
-        current_token = tokenizer.selectNext();
-        vector<string> values;
-        while (current_token.type != "RBRACE") {
-            if (current_token.type != "IDENTIFIER") {
+        advance();
+        vector<SymbolId> values;
+        while (current() != TokenType::RBRACE) {
+            if (current() != TokenType::IDENTIFIER) {
                 throw invalid_argument("Expected identifier in enum values");
             }
-            values.push_back(current_token.valueString);
-            current_token = tokenizer.selectNext();
-            if (current_token.type == "COMMA") {
-                current_token = tokenizer.selectNext();
+            values.push_back(symbol());
+            advance();
+            if (current() == TokenType::COMMA) {
+                advance();
             }
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<EnumNode>(enum_name, values);
+        advance();
+        return make<EnumNode>(enum_name, values);
     }
 
-    shared_ptr<Node> parse_struct_declaration() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "IDENTIFIER") {
+    NodePtr parse_struct_declaration() {
+        advance();
+        if (current() != TokenType::IDENTIFIER) {
             throw invalid_argument("Expected identifier after 'struct'");
         }
-        string struct_name = current_token.valueString;
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "LBRACE") {
+        SymbolId struct_name = symbol();
+        advance();
+        if (current() != TokenType::LBRACE) {
             throw invalid_argument("Expected '{' after struct name");
         }
-        current_token = tokenizer.selectNext();
-        vector<pair<string, string>> fields;
-        while (current_token.type != "RBRACE") {
-            if (current_token.type != "IDENTIFIER") {
+        advance();
+        vector<pair<SymbolId, SymbolId>> fields;
+        while (current() != TokenType::RBRACE) {
+            if (current() != TokenType::IDENTIFIER) {
                 throw invalid_argument("Expected type identifier in struct field declaration");
             }
-            string field_type = current_token.valueString;
-            current_token = tokenizer.selectNext();
-            if (current_token.type != "IDENTIFIER") {
+            SymbolId field_type = symbol();
+            advance();
+            if (current() != TokenType::IDENTIFIER) {
                 throw invalid_argument("Expected field name in struct field declaration");
             }
-            string field_name = current_token.valueString;
+            SymbolId field_name = symbol();
             fields.emplace_back(field_type, field_name);
 
-            current_token = tokenizer.selectNext();
-            if (current_token.type == "COMMA") {
-                current_token = tokenizer.selectNext();
-            } else if (current_token.type != "RBRACE") {
+            advance();
+            if (current() == TokenType::COMMA) {
+                advance();
+            } else if (current() != TokenType::RBRACE) {
                 throw invalid_argument("Expected '}' or ',' in struct declaration");
             }
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<StructNode>(struct_name, fields);
+        advance();
+        return make<StructNode>(struct_name, fields);
     }
 
-    shared_ptr<Node> parse_const_declaration() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "IDENTIFIER") {
+    NodePtr parse_const_declaration() {
+        advance();
+        if (current() != TokenType::IDENTIFIER) {
             throw invalid_argument("Expected identifier after 'const'");
         }
-        string var_name = current_token.valueString;
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "ASSIGN") {
+        SymbolId var_name = symbol();
+        advance();
+        if (current() != TokenType::ASSIGN) {
             throw invalid_argument("Expected '=' after identifier in constant declaration");
         }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> value_node = parse_expression_or_list();
-        if (current_token.type != "SEMICOLON") {
+        advance();
+        NodePtr value_node = parse_expression_or_list();
+        if (current() != TokenType::SEMICOLON) {
             throw invalid_argument("Expected ';' after constant declaration");
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<VarDeclareNode>(var_name, value_node);
+        advance();
+        return make<VarDeclareNode>(var_name, value_node, true);
     }
 
-    shared_ptr<Node> parse_expression_or_list() {
-        if (current_token.type == "LBRACKET") {
+    NodePtr parse_expression_or_list() {
+        if (current() == TokenType::LBRACKET) {
             return parse_list_initializer();
         } else {
             return parse_boolexpression();
         }
     }
 
-    shared_ptr<Node> parse_list_initializer() {
-        current_token = tokenizer.selectNext();
-        vector<shared_ptr<Node>> elements;
-        while (current_token.type != "RBRACKET") {
-            shared_ptr<Node> element = parse_expression();
+    NodePtr parse_list_initializer() {
+        advance();
+        vector<NodePtr> elements;
+        while (current() != TokenType::RBRACKET) {
+            NodePtr element = parse_expression();
             elements.push_back(element);
-            if (current_token.type == "COMMA") {
-                current_token = tokenizer.selectNext();
-            } else if (current_token.type != "RBRACKET") {
+            if (current() == TokenType::COMMA) {
+                advance();
+            } else if (current() != TokenType::RBRACKET) {
                 throw invalid_argument("Expected ']' or ',' in list initializer");
             }
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<ArrayNode>(elements);
+        advance();
+        return make<ArrayNode>(arena.copy(elements));
     }
 
-    shared_ptr<Node> parse_if_statement() {
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> condition = parse_boolexpression();
-        if (current_token.type != "LBRACE") {
+    NodePtr parse_if_statement() {
+        advance();
+        NodePtr condition = parse_boolexpression();
+        if (current() != TokenType::LBRACE) {
             throw invalid_argument("Expected '{' after if condition");
         }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> if_block = parse_block();
-        if (current_token.type != "RBRACE") {
+        advance();
+        NodePtr if_block = parse_block();
+        if (current() != TokenType::RBRACE) {
             throw invalid_argument("Expected '}' after if block");
         }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> else_block = make_shared<NoOpNode>();
-        if (current_token.type == "ELSE") {
-            current_token = tokenizer.selectNext();
-            if (current_token.type != "LBRACE") {
+        advance();
+        NodePtr else_block = make<NoOpNode>();
+        if (current() == TokenType::ELSE) {
+            advance();
+            if (current() != TokenType::LBRACE) {
                 throw invalid_argument("Expected '{' after else");
             }
-            current_token = tokenizer.selectNext();
+            advance();
             else_block = parse_block();
-            if (current_token.type != "RBRACE") {
+            if (current() != TokenType::RBRACE) {
                 throw invalid_argument("Expected '}' after else block");
             }
-            current_token = tokenizer.selectNext();
+            advance();
         }
-        return make_shared<IfNode>(condition, if_block, else_block);
+        return make<IfNode>(condition, if_block, else_block);
     }
 
-    shared_ptr<Node> parse_while_statement() {
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> condition = parse_boolexpression();
-        if (current_token.type != "LBRACE") {
+    NodePtr parse_while_statement() {
+        uint32_t while_offset = offset();
+        advance();
+        NodePtr condition = parse_boolexpression();
+        if (current() != TokenType::LBRACE) {
             throw invalid_argument("Expected '{' after while condition");
         }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> block_node = parse_block();
-        if (current_token.type != "RBRACE") {
+        advance();
+        NodePtr block_node = parse_block();
+        if (current() != TokenType::RBRACE) {
             throw invalid_argument("Expected '}' after while block");
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<WhileNode>(condition, block_node);
+        advance();
+        WhileNode* loop = make<WhileNode>(condition, block_node);
+        loop->offset = while_offset;
+        return loop;
     }
 
-    shared_ptr<Node> parse_return_statement() {
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> return_node = parse_boolexpression();
-        if (current_token.type != "SEMICOLON") {
+    NodePtr parse_return_statement() {
+        advance();
+        NodePtr return_node = parse_boolexpression();
+        if (current() != TokenType::SEMICOLON) {
             throw invalid_argument("Expected ';' after return statement");
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<ReturnNode>(return_node);
+        advance();
+        return make<ReturnNode>(return_node);
     }
 
-    shared_ptr<Node> parse_break_statement() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "SEMICOLON") {
+    NodePtr parse_break_statement() {
+        advance();
+        if (current() != TokenType::SEMICOLON) {
             throw invalid_argument("Expected ';' after break statement");
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<BreakNode>();
+        advance();
+        return make<BreakNode>();
     }
 
-    shared_ptr<Node> parse_continue_statement() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "SEMICOLON") {
+    NodePtr parse_continue_statement() {
+        advance();
+        if (current() != TokenType::SEMICOLON) {
             throw invalid_argument("Expected ';' after continue statement");
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<ContinueNode>();
+        advance();
+        return make<ContinueNode>();
     }
 
-    shared_ptr<Node> parse_function_declaration() {
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "IDENTIFIER") {
+    NodePtr parse_function_declaration() {
+        advance();
+        if (current() != TokenType::IDENTIFIER) {
             throw invalid_argument("Expected identifier after 'function'");
         }
-        string func_name = current_token.valueString;
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "LPAREN") {
+        SymbolId func_name = symbol();
+        advance();
+        if (current() != TokenType::LPAREN) {
             throw invalid_argument("Expected '(' after function name");
         }
-        current_token = tokenizer.selectNext();
-        vector<string> args;
-        while (current_token.type != "RPAREN") {
-            if (current_token.type != "IDENTIFIER") {
+        advance();
+        vector<SymbolId> args;
+        vector<ValueType> arg_types;
+        bool typed = false;
+        while (current() != TokenType::RPAREN) {
+            if (current() != TokenType::IDENTIFIER) {
                 throw invalid_argument("Expected identifier in function arguments");
             }
-            args.push_back(current_token.valueString);
-            current_token = tokenizer.selectNext();
-            if (current_token.type == "RPAREN") {
+            args.push_back(symbol());
+            advance();
+            arg_types.push_back(parse_type_annotation());
+            typed |= arg_types.back() != ValueType::Null;
+            if (current() == TokenType::RPAREN) {
                 break;
             }
-            if (current_token.type != "COMMA") {
+            if (current() != TokenType::COMMA) {
                 throw invalid_argument("Expected ',' after function argument");
             }
-            current_token = tokenizer.selectNext();
+            advance();
         }
-        current_token = tokenizer.selectNext();
-        if (current_token.type != "LBRACE") {
+        advance();
+        ValueType return_type = parse_type_annotation();
+        if (current() != TokenType::LBRACE) {
             throw invalid_argument("Expected '{' after function arguments");
         }
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> block_node = parse_block();
-        if (current_token.type != "RBRACE") {
+        advance();
+        NodePtr block_node = parse_block();
+        if (current() != TokenType::RBRACE) {
             throw invalid_argument("Expected '}' after function block");
         }
-        current_token = tokenizer.selectNext();
-        return make_shared<FuncDeclareNode>(func_name, args, block_node);
+        advance();
+        if (!typed) { arg_types.clear(); }
+        return make<FuncDeclareNode>(func_name, arena.copy(args), arena.copy(arg_types), return_type, block_node);
+    }
+
+    // Optional `: type` after a parameter or a parameter list
+    ValueType parse_type_annotation() {
+        if (current() != TokenType::COLON) { return ValueType::Null; }
+        advance();
+        if (current() != TokenType::IDENTIFIER) {
+            throw invalid_argument("Expected type identifier after ':'");
+        }
+        ValueType type = valueTypeNamed(text());
+        advance();
+        return type;
     }
 
-    shared_ptr<Node> parse_vardec_assignment_funccall() {
-        if (current_token.type != "IDENTIFIER") {
+    NodePtr parse_vardec_assignment_funccall() {
+        if (current() != TokenType::IDENTIFIER) {
             throw invalid_argument("Expected identifier");
         }
-        string identifier = current_token.valueString;
-        current_token = tokenizer.selectNext();
-        if (current_token.type == "ASSIGN") {
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> value_node = parse_boolexpression();
-            if (current_token.type != "SEMICOLON") {
-                throw invalid_argument("Expected ';' after assignment");
-            }
-            current_token = tokenizer.selectNext();
-            return make_shared<AssignmentNode>(identifier, value_node);
-        } else if (current_token.type == "LPAREN") {
-            current_token = tokenizer.selectNext();
-            vector<shared_ptr<Node>> args;
-            while (current_token.type != "RPAREN") {
-                args.push_back(parse_boolexpression());
-                if (current_token.type == "RPAREN") {
-                    break;
-                }
-                if (current_token.type != "COMMA") {
-                    throw invalid_argument("Expected ',' after function argument");
-                }
-                current_token = tokenizer.selectNext();
-            }
-            current_token = tokenizer.selectNext();
-            if (current_token.type != "SEMICOLON") {
-                throw invalid_argument("Expected ';' after function call");
-            }
-            current_token = tokenizer.selectNext();
-            return make_shared<FuncCallNode>(identifier, args);
-        } else if (current_token.type == "COLON") {
-            current_token = tokenizer.selectNext();
-            if (current_token.type != "IDENTIFIER") {
-                throw invalid_argument("Expected type identifier after ':' in variable declaration");
-            }
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> value_node;
-            if (current_token.type == "ASSIGN") {
-                current_token = tokenizer.selectNext();
-                value_node = parse_expression_or_list();
-            }
-            if (current_token.type != "SEMICOLON") {
-                throw invalid_argument("Expected ';' after variable declaration");
-            }
-            current_token = tokenizer.selectNext();
-            return make_shared<VarDeclareNode>(identifier, value_node);
-        }
-        else {
+        TokenType following = peek();
+        if (following == TokenType::ASSIGN) {
+            return parse_assignment();
+        } else if (following == TokenType::LPAREN) {
+            return parse_funccall_statement();
+        } else if (following == TokenType::COLON) {
+            return parse_variable_declaration();
+        } else {
             throw invalid_argument("Unexpected token after identifier");
         }
     }
 
-    shared_ptr<Node> parse_boolexpression() {
-        shared_ptr<Node> bool_expression_node = parse_boolterm();
-        while (current_token.type == "OR") {
-            Token op_token = current_token;
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> next_bool_term_node = parse_boolterm();
-            bool_expression_node = make_shared<BinOpNode>("or", bool_expression_node, next_bool_term_node);
+    NodePtr parse_assignment() {
+        SymbolId identifier = symbol();
+        advance();
+        advance();
+        NodePtr value_node = parse_boolexpression();
+        if (current() != TokenType::SEMICOLON) {
+            throw invalid_argument("Expected ';' after assignment");
+        }
+        advance();
+        return make<AssignmentNode>(identifier, value_node);
+    }
+
+    NodePtr parse_funccall_statement() {
+        SymbolId identifier = symbol();
+        advance();
+        vector<NodePtr> args = parse_call_arguments();
+        if (current() != TokenType::SEMICOLON) {
+            throw invalid_argument("Expected ';' after function call");
+        }
+        advance();
+        return make_call(identifier, args);
+    }
+
+    NodePtr parse_variable_declaration() {
+        SymbolId identifier = symbol();
+        advance();
+        advance();
+        if (current() != TokenType::IDENTIFIER) {
+            throw invalid_argument("Expected type identifier after ':' in variable declaration");
+        }
+        ValueType declared = valueTypeNamed(text());
+        advance();
+        NodePtr value_node = nullptr;
+        if (current() == TokenType::ASSIGN) {
+            advance();
+            value_node = parse_expression_or_list();
+        }
+        if (current() != TokenType::SEMICOLON) {
+            throw invalid_argument("Expected ';' after variable declaration");
+        }
+        advance();
+        VarDeclareNode* declaration = make<VarDeclareNode>(identifier, value_node);
+        declaration->declared = declared;
+        return declaration;
+    }
+
+    // Calls to registered natives are bound to their Builtins entry here, and their argument count is checked up front
+    NodePtr make_call(SymbolId identifier, const vector<NodePtr>& args) {
+        const Builtin* builtin = Builtins::global().find(identifier);
+        if (builtin && (args.size() < builtin->min_args || args.size() > builtin->max_args)) {
+            throw invalid_argument("Function " + symbol_name(identifier) + " called with " + to_string(args.size()) + " arguments");
+        }
+        return make<FuncCallNode>(identifier, arena.copy(args), builtin);
+    }
+
+    // Parses "(" [expression {"," expression}] ")" starting at the opening parenthesis
+    vector<NodePtr> parse_call_arguments() {
+        advance();
+        vector<NodePtr> args;
+        while (current() != TokenType::RPAREN) {
+            args.push_back(parse_boolexpression());
+            if (current() == TokenType::RPAREN) { break; }
+            if (current() != TokenType::COMMA) { throw invalid_argument("Expected ',' after function argument"); }
+            advance();
+        }
+        advance();
+        return args;
+    }
+
+    NodePtr parse_boolexpression() {
+        NodePtr bool_expression_node = parse_boolterm();
+        while (current() == TokenType::OR) {
+            advance();
+            NodePtr next_bool_term_node = parse_boolterm();
+            bool_expression_node = make<BinOpNode>(BinOp::Or, bool_expression_node, next_bool_term_node);
         }
         return bool_expression_node;
     }
 
-    shared_ptr<Node> parse_boolterm() {
-        shared_ptr<Node> bool_term_node = parse_relexpression();
-        while (current_token.type == "AND") {
-            Token op_token = current_token;
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> next_rel_expression_node = parse_relexpression();
-            bool_term_node = make_shared<BinOpNode>("and", bool_term_node, next_rel_expression_node);
+    NodePtr parse_boolterm() {
+        NodePtr bool_term_node = parse_relexpression();
+        while (current() == TokenType::AND) {
+            advance();
+            NodePtr next_rel_expression_node = parse_relexpression();
+            bool_term_node = make<BinOpNode>(BinOp::And, bool_term_node, next_rel_expression_node);
         }
         return bool_term_node;
     }
 
-    shared_ptr<Node> parse_relexpression() {
-        shared_ptr<Node> relexpression_node = parse_expression();
-        while (current_token.type == "EQ" || current_token.type == "NEQ" 
-        || current_token.type == "GT" || current_token.type == "LT" || current_token.type == "GE" || current_token.type == "LE") {
-            Token op_token = current_token;
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> next_expression_node = parse_expression();
-            if (op_token.type == "GT") { relexpression_node = make_shared<BinOpNode>(">", relexpression_node, next_expression_node); }
-            else if (op_token.type == "LT") { relexpression_node = make_shared<BinOpNode>("<", relexpression_node, next_expression_node); }
-            else if (op_token.type == "GE") { relexpression_node = make_shared<BinOpNode>(">=", relexpression_node, next_expression_node); }
-            else if (op_token.type == "LE") { relexpression_node = make_shared<BinOpNode>("<=", relexpression_node, next_expression_node); }
-            else if (op_token.type == "EQ") { relexpression_node = make_shared<BinOpNode>("==", relexpression_node, next_expression_node); }
-            else { relexpression_node = make_shared<BinOpNode>("!=", relexpression_node, next_expression_node); }
+    NodePtr parse_relexpression() {
+        NodePtr relexpression_node = parse_expression();
+        while (current() == TokenType::EQ || current() == TokenType::NEQ 
+        || current() == TokenType::GT || current() == TokenType::LT || current() == TokenType::GE || current() == TokenType::LE) {
+            TokenType op = current();
+            advance();
+            NodePtr next_expression_node = parse_expression();
+            if (op == TokenType::GT) { relexpression_node = make<BinOpNode>(BinOp::Gt, relexpression_node, next_expression_node); }
+            else if (op == TokenType::LT) { relexpression_node = make<BinOpNode>(BinOp::Lt, relexpression_node, next_expression_node); }
+            else if (op == TokenType::GE) { relexpression_node = make<BinOpNode>(BinOp::Ge, relexpression_node, next_expression_node); }
+            else if (op == TokenType::LE) { relexpression_node = make<BinOpNode>(BinOp::Le, relexpression_node, next_expression_node); }
+            else if (op == TokenType::EQ) { relexpression_node = make<BinOpNode>(BinOp::Eq, relexpression_node, next_expression_node); }
+            else { relexpression_node = make<BinOpNode>(BinOp::Ne, relexpression_node, next_expression_node); }
         }
         return relexpression_node;
     }
 
-    shared_ptr<Node> parse_expression() {
-        shared_ptr<Node> expression_node = parse_term();
-        while (current_token.type == "PLUS" || current_token.type == "MINUS" || current_token.type == "CONCAT") {
-            Token op_token = current_token;
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> next_term_node = parse_term();
-            if (op_token.type == "PLUS") { expression_node = make_shared<BinOpNode>("+", expression_node, next_term_node); }
-            else if (op_token.type == "MINUS") { expression_node = make_shared<BinOpNode>("-", expression_node, next_term_node); } 
-            else if (op_token.type == "CONCAT") { expression_node = make_shared<BinOpNode>("..", expression_node, next_term_node); }
+    NodePtr parse_expression() {
+        NodePtr expression_node = parse_term();
+        while (current() == TokenType::PLUS || current() == TokenType::MINUS || current() == TokenType::CONCAT) {
+            TokenType op = current();
+            advance();
+            NodePtr next_term_node = parse_term();
+            if (op == TokenType::PLUS) { expression_node = make<BinOpNode>(BinOp::Add, expression_node, next_term_node); }
+            else if (op == TokenType::MINUS) { expression_node = make<BinOpNode>(BinOp::Sub, expression_node, next_term_node); } 
+            else if (op == TokenType::CONCAT) { expression_node = make<BinOpNode>(BinOp::Concat, expression_node, next_term_node); }
         }
         return expression_node;
     }
 
-    shared_ptr<Node> parse_term() {
-        shared_ptr<Node> term_node = parse_factor();
-        while (current_token.type == "MULT" || current_token.type == "DIV" || current_token.type == "MOD") {
-            Token op_token = current_token;
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> next_factor_node = parse_factor();
-            if (op_token.type == "MULT") { term_node = make_shared<BinOpNode>("*", term_node, next_factor_node); }
-            else if (op_token.type == "DIV") { term_node = make_shared<BinOpNode>("/", term_node, next_factor_node); }
-            else { term_node = make_shared<BinOpNode>("%", term_node, next_factor_node); }
+    NodePtr parse_term() {
+        NodePtr term_node = parse_factor();
+        while (current() == TokenType::MULT || current() == TokenType::DIV || current() == TokenType::MOD) {
+            TokenType op = current();
+            advance();
+            NodePtr next_factor_node = parse_factor();
+            if (op == TokenType::MULT) { term_node = make<BinOpNode>(BinOp::Mul, term_node, next_factor_node); }
+            else if (op == TokenType::DIV) { term_node = make<BinOpNode>(BinOp::Div, term_node, next_factor_node); }
+            else { term_node = make<BinOpNode>(BinOp::Mod, term_node, next_factor_node); }
         }
         return term_node;
     }
 
-    shared_ptr<Node> parse_factor() {
-        if (current_token.type == "NUMBER_LITERAL") {
-            int value = current_token.value;
-            current_token = tokenizer.selectNext();
-            return make_shared<IntValNode>(value);
-        }
-        else if (current_token.type == "STRING_LITERAL") {
-            string value = current_token.valueString;
-            current_token = tokenizer.selectNext();
-            return make_shared<StringValNode>(value);
-        }
-        else if (current_token.type == "LPAREN") {
-            current_token = tokenizer.selectNext();
-            shared_ptr<Node> bool_expression_node = parse_boolexpression();
-            if (current_token.type != "RPAREN") { throw invalid_argument("Expected ')' after expression"); }
-            current_token = tokenizer.selectNext();
+    NodePtr parse_factor() {
+        if (current() == TokenType::NUMBER_LITERAL) {
+            const NumberLiteral& literal = number();
+            NodePtr value = literal.is_double ? static_cast<NodePtr>(make<DoubleValNode>(literal.double_value)) : make<IntValNode>(literal.int_value);
+            advance();
+            return value;
+        }
+        else if (current() == TokenType::STRING_LITERAL) {
+            string value = Tokenizer::unescape(text());
+            advance();
+            return make<StringValNode>(value);
+        }
+        else if (current() == TokenType::LPAREN) {
+            advance();
+            NodePtr bool_expression_node = parse_boolexpression();
+            if (current() != TokenType::RPAREN) { throw invalid_argument("Expected ')' after expression"); }
+            advance();
             return bool_expression_node;
         }
-        else if (current_token.type == "MINUS") {
-            current_token = tokenizer.selectNext();
-            return make_shared<BinOpNode>("-", make_shared<IntValNode>(0), parse_factor());
+        else if (current() == TokenType::MINUS) {
+            advance();
+            return make<BinOpNode>(BinOp::Sub, make<IntValNode>(0), parse_factor());
         }
-        else if (current_token.type == "PLUS") {
-            current_token = tokenizer.selectNext();
+        else if (current() == TokenType::PLUS) {
+            advance();
             return parse_factor();
         }
-        else if (current_token.type == "NOT") {
-            current_token = tokenizer.selectNext();
-            return make_shared<UnOpNode>("!", parse_factor());
-        }
-        else if (current_token.type == "IDENTIFIER") {
-            string identifier = current_token.valueString;
-            current_token = tokenizer.selectNext();
-            if (current_token.type == "DOT") {
-                current_token = tokenizer.selectNext();
-                if (current_token.type != "IDENTIFIER") { throw invalid_argument("Expected field name after '.'"); }
-                string field_name = current_token.valueString;
-                current_token = tokenizer.selectNext();
-                return make_shared<StructFieldNode>(identifier, field_name);
+        else if (current() == TokenType::NOT) {
+            advance();
+            return make<UnOpNode>(UnOp::Not, parse_factor());
+        }
+        else if (current() == TokenType::IDENTIFIER) {
+            SymbolId identifier = symbol();
+            advance();
+            if (current() == TokenType::DOT) {
+                advance();
+                if (current() != TokenType::IDENTIFIER) { throw invalid_argument("Expected field name after '.'"); }
+                SymbolId field_name = symbol();
+                advance();
+                return make<StructFieldNode>(identifier, field_name);
             }
-            else if (current_token.type == "LPAREN") {
-                current_token = tokenizer.selectNext();
-                vector<shared_ptr<Node>> args;
-                while (current_token.type != "RPAREN") {
-                    args.push_back(parse_boolexpression());
-                    if (current_token.type == "RPAREN") { break; }
-                    if (current_token.type != "COMMA") { throw invalid_argument("Expected ',' after function argument"); }
-                    current_token = tokenizer.selectNext();
-                }
-                current_token = tokenizer.selectNext();
-                return make_shared<FuncCallNode>(identifier, args);
+            else if (current() == TokenType::LPAREN) {
+                return make_call(identifier, parse_call_arguments());
             }
-            else if (current_token.type == "COLON") {
-                current_token = tokenizer.selectNext();
-                if (current_token.type != "IDENTIFIER") {
+            else if (current() == TokenType::COLON) {
+                advance();
+                if (current() != TokenType::IDENTIFIER) {
                     throw invalid_argument("Expected enum value after '::'");
                 }
-                string enum_value = current_token.valueString;
-                current_token = tokenizer.selectNext();
-                return make_shared<EnumValNode>(identifier, enum_value);
+                SymbolId enum_value = symbol();
+                advance();
+                return make<EnumValNode>(identifier, enum_value);
             }
-            else if (current_token.type == "LBRACKET") {
-                current_token = tokenizer.selectNext();
-                shared_ptr<Node> index = parse_boolexpression();
-                if (current_token.type != "RBRACKET") { throw invalid_argument("Expected ']' after array index"); }
-                current_token = tokenizer.selectNext();
-                return make_shared<ArrayAccessNode>(identifier, index);
+            else if (current() == TokenType::LBRACKET) {
+                advance();
+                NodePtr index = parse_boolexpression();
+                if (current() != TokenType::RBRACKET) { throw invalid_argument("Expected ']' after array index"); }
+                advance();
+                return make<ArrayAccessNode>(identifier, index);
             }
             else {
-                return make_shared<VarNode>(identifier);
+                return make<VarNode>(identifier);
             }
         }
-        throw invalid_argument("Unexpected token: " + current_token.type);
+        throw invalid_argument("Unexpected token: " + string(tokenTypeName(current())));
     }
 
-    shared_ptr<Node> run(const string& code) {
-        current_token = tokenizer.selectNext();
-        shared_ptr<Node> root = parse_program();
-        if (current_token.type != "EOF") { throw invalid_argument("Expected EOF"); }
+    NodePtr run(string_view code) {
+        tokens = TokenBuffer();
+        cursor = 0;
+        if (parallel_lexing) { Tokenizer::tokenizeParallel(code, tokens); }
+        else { Tokenizer(code).tokenize(tokens); }
+        NodePtr root = parse_program();
+        if (current() != TokenType::END_OF_FILE) { throw invalid_argument("Expected EOF"); }
+        root = Optimizer(arena).run(root);
+        Resolver().run(root);
+        TypeChecker().run(root);
+        cost::annotate(root);
         return root;
     }
+
+    // Parses every source on a pool of worker threads, one Parser per script; results keep the order of sources
+    // and each tree comes with the arena that owns it. Lexing inside each parse stays single-threaded so the pool
+    // is not oversubscribed. The first parse error is rethrown once all workers have finished.
+    static vector<ParsedScript> run_concurrently(const vector<string_view>& sources, unsigned thread_count = thread::hardware_concurrency()) {
+        vector<ParsedScript> scripts(sources.size());
+        vector<exception_ptr> errors(sources.size());
+        atomic<size_t> next_source = 0;
+        auto worker = [&]() {
+            for (size_t i = next_source++; i < sources.size(); i = next_source++) {
+                scripts[i].arena = make_unique<Arena>();
+                Parser parser(*scripts[i].arena);
+                parser.parallel_lexing = false;
+                try { scripts[i].root = parser.run(sources[i]); }
+                catch (...) { errors[i] = current_exception(); }
+            }
+        };
+        vector<thread> workers;
+        for (unsigned t = 1; t < max(1u, min<unsigned>(thread_count, sources.size())); ++t) { workers.emplace_back(worker); }
+        worker();
+        for (thread& t : workers) { t.join(); }
+        for (const exception_ptr& error : errors) {
+            if (error) { rethrow_exception(error); }
+        }
+        return scripts;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Assigns every variable a fixed slot in the frame it lives in, so evaluation indexes an array instead of hashing
+// names. setup, main and threadloops share the global frame; each function gets its own frame, with its
+// parameters in the first slots. It also marks returns of user function calls inside function bodies as tail
+// calls, which then reuse the returning function's frame.
+class Resolver {
+private:
+    vector<unordered_map<SymbolId, uint32_t>> scopes;
+    // False in setup, main and threadloop bodies, whose return does not hand a value back to a caller
+    bool in_function = false;
+
+    uint32_t slot_for(SymbolId name) {
+        auto& slots = scopes.back();
+        return slots.emplace(name, static_cast<uint32_t>(slots.size())).first->second;
+    }
+
+    // Binding a repeated parameter name twice leaves the later argument in the variable, so the name maps to
+    // the last position
+    void begin_frame(ArenaSpan<SymbolId> parameters) {
+        scopes.emplace_back();
+        for (size_t i = 0; i < parameters.size(); ++i) { scopes.back()[parameters[i]] = i; }
+    }
+
+    uint32_t end_frame(size_t parameter_count) {
+        uint32_t size = max<size_t>(scopes.back().size(), parameter_count);
+        scopes.pop_back();
+        return size;
+    }
+
+    void resolve_list(NodeList nodes) {
+        for (NodePtr node : nodes) { resolve(node); }
+    }
+
+public:
+    void run(NodePtr root) {
+        scopes.clear();
+        in_function = false;
+        resolve(root);
+    }
+
+    void resolve(NodePtr node) {
+        if (!node) { return; }
+        switch (node->kind) {
+            case NodeKind::Var: {
+                auto var = static_cast<VarNode*>(node);
+                var->slot = slot_for(var->identifier);
+                break;
+            }
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                resolve(declare->expression);
+                declare->slot = slot_for(declare->identifier);
+                break;
+            }
+            case NodeKind::Assignment: {
+                auto assignment = static_cast<AssignmentNode*>(node);
+                resolve(assignment->expression);
+                assignment->slot = slot_for(assignment->identifier);
+                break;
+            }
+            case NodeKind::ArrayAccess: {
+                auto access = static_cast<ArrayAccessNode*>(node);
+                access->slot = slot_for(access->identifier);
+                resolve(access->index);
+                break;
+            }
+            case NodeKind::BinOp:
+                resolve(static_cast<BinOpNode*>(node)->left);
+                resolve(static_cast<BinOpNode*>(node)->right);
+                break;
+            case NodeKind::UnOp: resolve(static_cast<UnOpNode*>(node)->child); break;
+            case NodeKind::While:
+                resolve(static_cast<WhileNode*>(node)->condition);
+                resolve(static_cast<WhileNode*>(node)->block);
+                break;
+            case NodeKind::If:
+                resolve(static_cast<IfNode*>(node)->condition);
+                resolve(static_cast<IfNode*>(node)->block);
+                resolve(static_cast<IfNode*>(node)->else_block);
+                break;
+            case NodeKind::FuncDeclare: {
+                auto function = static_cast<FuncDeclareNode*>(node);
+                bool outer = in_function;
+                in_function = true;
+                begin_frame(function->args);
+                resolve(function->block_node);
+                function->frame_size = end_frame(function->args.size());
+                in_function = outer;
+                break;
+            }
+            case NodeKind::FuncCall: resolve_list(static_cast<FuncCallNode*>(node)->args); break;
+            case NodeKind::Return: {
+                auto ret = static_cast<ReturnNode*>(node);
+                resolve(ret->return_node);
+                ret->tail_call = in_function && ret->return_node->kind == NodeKind::FuncCall && !static_cast<FuncCallNode*>(ret->return_node)->builtin;
+                break;
+            }
+            case NodeKind::Block: resolve_list(static_cast<BlockNode*>(node)->statements); break;
+            case NodeKind::Program: {
+                auto program = static_cast<ProgramNode*>(node);
+                begin_frame({});
+                resolve(program->setup_block);
+                resolve(program->main_block);
+                program->frame_size = end_frame(0);
+                break;
+            }
+            case NodeKind::Array: resolve_list(static_cast<ArrayNode*>(node)->nodes); break;
+            case NodeKind::ThreadLoop: {
+                bool outer = in_function;
+                in_function = false;
+                resolve(static_cast<ThreadLoopNode*>(node)->block);
+                in_function = outer;
+                break;
+            }
+            default: break;
+        }
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Builtins.h"
+#include "Operators.h"
+#include "Value.h"
+using namespace std;
+
+// Support code for the C++ programs hrlc generates. Everything here mirrors what the interpreter does for the same
+// node, including its error messages, so a compiled script behaves like an interpreted one.
+namespace hrl {
+
+// A variable of a compiled frame; like a SymbolTable slot it stays undefined until something is stored in it
+struct Var {
+    Value value;
+    bool defined = false;
+
+    const Value& get(const char* name) const {
+        if (!defined) { throw invalid_argument(string("Undefined variable: ") + name); }
+        return value;
+    }
+
+    void set(Value new_value, const char* name) {
+        if (new_value.is_null()) { throw invalid_argument(string("Cannot assign NULL value to variable ") + name); }
+        value = move(new_value);
+        defined = true;
+    }
+};
+
+// Declarations in the global frame are serialised like VarDeclareNode's critical section, since threadloops share it
+inline void declare(Var& var, Value value, const char* name) {
+    static mutex lock;
+    lock_guard<mutex> guard(lock);
+    var.set(move(value), name);
+}
+
+// A store into a typed variable the type checker could not prove; NULL is left for set() to report, as in
+// VarDeclareNode
+inline Value checked(Value value, ValueType declared, const char* name) {
+    if (!value.is_null() && !ops::conform(value, declared)) { throw ops::type_mismatch(name, declared, value.type()); }
+    return value;
+}
+
+// An argument for a parameter with a declared type, as in FuncCallNode::check_arguments
+inline Value argument(Value value, ValueType declared, const char* name) {
+    if (!ops::conform(value, declared)) { throw ops::type_mismatch(name, declared, value.type()); }
+    return value;
+}
+
+// Both operands of an operator, built from a braced list so they are evaluated left to right like in the interpreter
+struct Operands {
+    Value left, right;
+};
+
+template <BinOp op>
+inline Value binop(Operands operands) { return ops::apply(op, operands.left, operands.right); }
+
+inline Value element(Operands operands) {
+    if (!operands.left.is_array()) { throw runtime_error("Unsupported array type."); }
+    return operands.left.element(operands.right.as_int());
+}
+
+// Natives are looked up in the same registry the parser binds against, once, when the program starts
+inline NativeFunction native(string_view name) {
+    const Builtin* builtin = Builtins::global().find(intern(name));
+    if (!builtin) { throw invalid_argument("Unknown builtin: " + string(name)); }
+    return builtin->function;
+}
+
+inline Value call(NativeFunction function, initializer_list<Value> args) { return function(args.begin(), args.size()); }
+
+// Calls hrlc could not bind fail when they run, as they would in the interpreter
+inline Value undefined_function(const char* name) { throw invalid_argument(string("Undefined function: ") + name); }
+
+inline Value wrong_arity(const char* name, size_t expected, size_t given) {
+    throw invalid_argument(string("Function ") + name + " expects " + to_string(expected) + " arguments, but " + to_string(given) + " were given");
+}
+
+// A function can only be called once its declaration has run, and only be declared once, as with FuncTable
+inline void declare_function(atomic<bool>& declared, const char* name) {
+    if (declared.exchange(true)) { throw invalid_argument(string("Function already declared: ") + name); }
+}
+
+inline void check_declared(const atomic<bool>& declared, const char* name) {
+    if (!declared.load(memory_order_acquire)) { undefined_function(name); }
+}
+
+// A tail call to another function returns to the nearest settle(), which makes the call, so a chain of tail calls
+// between functions runs in constant stack. Calls to self are plain jumps and never get here.
+struct TailCall {
+    Value (*target)(vector<Value>& args) = nullptr;
+    vector<Value> args;
+};
+
+inline TailCall& pending_tail_call() {
+    thread_local TailCall call;
+    return call;
+}
+
+template <size_t N>
+inline Value tail_call(Value (*target)(vector<Value>&), array<Value, N> args) {
+    TailCall& call = pending_tail_call();
+    call.target = target;
+    call.args.assign(make_move_iterator(args.begin()), make_move_iterator(args.end()));
+    return Value();
+}
+
+inline Value settle(Value result) {
+    TailCall& call = pending_tail_call();
+    while (call.target) {
+        auto target = call.target;
+        call.target = nullptr;
+        result = target(call.args);
+    }
+    return result;
+}
+
+// No statement creates struct instances, so reading a field always fails
+inline Value struct_field(const char* instance, const char* field) {
+    throw runtime_error(string("Struct instance '") + instance + "' not found.");
+}
+
+// The enums declared in one frame, by name
+class Enums {
+private:
+    unordered_map<string, unordered_map<string, int>> enums;
+
+public:
+    void set(const string& name, initializer_list<const char*> values) {
+        unordered_map<string, int> enum_values;
+        int index = 0;
+        for (const char* value : values) { enum_values[value] = index++; }
+        enums[name] = move(enum_values);
+    }
+
+    int get(const string& enum_name, const string& value_name) const {
+        auto it = enums.find(enum_name);
+        if (it != enums.end()) {
+            auto value = it->second.find(value_name);
+            if (value != it->second.end()) { return value->second; }
+        }
+        throw invalid_argument("Undefined enum or value: " + enum_name + "::" + value_name);
+    }
+};
+
+}
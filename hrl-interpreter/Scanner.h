@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HRL_SCANNER_X86 1
+#endif
+using namespace std;
+
+// Character-class scanning kernels used by the tokenizer's hot loops. Each kernel returns a pointer to the first
+// byte in [p, end) that does NOT belong to its class (for scan_string: the first '"' or '\\').
+struct ScanKernels {
+    const char* name;
+    const char* (*skip_whitespace)(const char* p, const char* end);
+    const char* (*scan_identifier)(const char* p, const char* end);
+    const char* (*scan_string)(const char* p, const char* end);
+    const char* (*scan_digits)(const char* p, const char* end);
+};
+
+namespace scan {
+
+inline bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool is_ident(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; }
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char* scalar_skip_whitespace(const char* p, const char* end) { while (p < end && is_space(*p)) { ++p; } return p; }
+inline const char* scalar_scan_identifier(const char* p, const char* end) { while (p < end && is_ident(*p)) { ++p; } return p; }
+inline const char* scalar_scan_string(const char* p, const char* end) { while (p < end && *p != '"' && *p != '\\') { ++p; } return p; }
+inline const char* scalar_scan_digits(const char* p, const char* end) { while (p < end && is_digit(*p)) { ++p; } return p; }
+
+#ifdef HRL_SCANNER_X86
+// Signed byte compares are enough: every byte in the accepted classes is ASCII, and bytes >= 0x80 compare negative
+
+__attribute__((target("sse2"))) inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+__attribute__((target("sse2"))) inline unsigned sse2_space_mask(__m128i v) {
+    return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), sse2_in_range(v, '\t', '\r')));
+}
+
+__attribute__((target("sse2"))) inline unsigned sse2_ident_mask(__m128i v) {
+    __m128i letters = _mm_or_si128(sse2_in_range(v, 'a', 'z'), sse2_in_range(v, 'A', 'Z'));
+    __m128i others = _mm_or_si128(sse2_in_range(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    return _mm_movemask_epi8(_mm_or_si128(letters, others));
+}
+
+__attribute__((target("sse2"))) inline unsigned sse2_string_stop_mask(__m128i v) {
+    return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+}
+
+__attribute__((target("sse2"))) inline unsigned sse2_digit_mask(__m128i v) {
+    return _mm_movemask_epi8(sse2_in_range(v, '0', '9'));
+}
+
+// Runs a 16-byte mask kernel over [p, end); the block loop stops at the first byte outside the class
+template <unsigned (*Mask)(__m128i), bool Inverted, const char* (*Tail)(const char*, const char*)>
+__attribute__((target("sse2"))) inline const char* sse2_scan(const char* p, const char* end) {
+    for (; p + 16 <= end; p += 16) {
+        unsigned mask = Mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        if (Inverted) { mask = ~mask & 0xFFFFu; }
+        if (mask != 0) { return p + __builtin_ctz(mask); }
+    }
+    return Tail(p, end);
+}
+
+__attribute__((target("avx2"))) inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+__attribute__((target("avx2"))) inline unsigned avx2_space_mask(__m256i v) {
+    return _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), avx2_in_range(v, '\t', '\r')));
+}
+
+__attribute__((target("avx2"))) inline unsigned avx2_ident_mask(__m256i v) {
+    __m256i letters = _mm256_or_si256(avx2_in_range(v, 'a', 'z'), avx2_in_range(v, 'A', 'Z'));
+    __m256i others = _mm256_or_si256(avx2_in_range(v, '0', '9'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    return _mm256_movemask_epi8(_mm256_or_si256(letters, others));
+}
+
+__attribute__((target("avx2"))) inline unsigned avx2_string_stop_mask(__m256i v) {
+    return _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+}
+
+__attribute__((target("avx2"))) inline unsigned avx2_digit_mask(__m256i v) {
+    return _mm256_movemask_epi8(avx2_in_range(v, '0', '9'));
+}
+
+template <unsigned (*Mask)(__m256i), bool Inverted, const char* (*Tail)(const char*, const char*)>
+__attribute__((target("avx2"))) inline const char* avx2_scan(const char* p, const char* end) {
+    for (; p + 32 <= end; p += 32) {
+        unsigned mask = Mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        if (Inverted) { mask = ~mask; }
+        if (mask != 0) { return p + __builtin_ctz(mask); }
+    }
+    return Tail(p, end);
+}
+#endif
+
+inline const ScanKernels scalar_kernels = { "scalar", scalar_skip_whitespace, scalar_scan_identifier, scalar_scan_string, scalar_scan_digits };
+#ifdef HRL_SCANNER_X86
+inline const ScanKernels sse2_kernels = {
+    "sse2",
+    sse2_scan<sse2_space_mask, true, scalar_skip_whitespace>,
+    sse2_scan<sse2_ident_mask, true, scalar_scan_identifier>,
+    sse2_scan<sse2_string_stop_mask, false, scalar_scan_string>,
+    sse2_scan<sse2_digit_mask, true, scalar_scan_digits>
+};
+inline const ScanKernels avx2_kernels = {
+    "avx2",
+    avx2_scan<avx2_space_mask, true, scalar_skip_whitespace>,
+    avx2_scan<avx2_ident_mask, true, scalar_scan_identifier>,
+    avx2_scan<avx2_string_stop_mask, false, scalar_scan_string>,
+    avx2_scan<avx2_digit_mask, true, scalar_scan_digits>
+};
+#endif
+
+// Picks the widest kernel set the CPU supports; HRL_SCAN=scalar|sse2|avx2 overrides it (e.g. for benchmarking)
+inline const ScanKernels& detect() {
+    const char* forced = getenv("HRL_SCAN");
+    if (forced && strcmp(forced, "scalar") == 0) { return scalar_kernels; }
+#ifdef HRL_SCANNER_X86
+    __builtin_cpu_init();
+    bool prefer_sse2 = forced && strcmp(forced, "sse2") == 0;
+    if (!prefer_sse2 && __builtin_cpu_supports("avx2")) { return avx2_kernels; }
+    if (__builtin_cpu_supports("sse2")) { return sse2_kernels; }
+#endif
+    return scalar_kernels;
+}
+
+inline const ScanKernels& kernels() {
+    static const ScanKernels& selected = detect();
+    return selected;
+}
+
+}
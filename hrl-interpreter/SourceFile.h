@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+// Owns the bytes of an HRL script for the lifetime of the process. Regular files are memory-mapped; pipes,
+// stdin and anything else mmap refuses are read in bulk. Tokens and literals are views into this buffer.
+class SourceFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    string buffer;
+
+    bool read_all(int fd, size_t size_hint) {
+        buffer.resize(size_hint > 0 ? size_hint : 1 << 16);
+        size_t length = 0;
+        while (true) {
+            if (length == buffer.size()) { buffer.resize(buffer.size() * 2); }
+            ssize_t count = ::read(fd, buffer.data() + length, buffer.size() - length);
+            if (count < 0) { return false; }
+            if (count == 0) { break; }
+            length += count;
+        }
+        buffer.resize(length);
+        data = buffer.data();
+        size = length;
+        return true;
+    }
+
+public:
+    SourceFile() = default;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile() { if (mapped) { munmap(const_cast<char*>(data), size); } }
+
+    // Loads the file at path, or stdin when path is "-". Returns false if it cannot be opened or read.
+    bool open(const string& path) {
+        int fd = (path == "-") ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        struct stat info;
+        bool ok = false;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* region = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (region != MAP_FAILED) {
+                madvise(region, info.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(region);
+                size = info.st_size;
+                mapped = true;
+                ok = true;
+            } else {
+                ok = read_all(fd, info.st_size + 1);
+            }
+        } else {
+            ok = read_all(fd, 0);
+        }
+        if (fd != STDIN_FILENO) { ::close(fd); }
+        return ok;
+    }
+
+    string_view view() const { return string_view(data, size); }
+};
@@ -1,90 +1,202 @@
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <unordered_map>
 #include <string>
 #include <stdexcept>
-#include <variant>
+#include "Arena.h"
+#include "FramePool.h"
+#include "Interner.h"
+#include "Value.h"
 using namespace std;
 
 class Node;
-using NodePtr = shared_ptr<Node>;
-using EvalResult = variant<int, string, double, bool, vector<int>, vector<string>, vector<double>, vector<bool>>;
+class FuncCallNode;
+struct Chunk;
+using NodePtr = Node*;
+using EvalResult = Value;
 
+// Native code from the JIT takes the int arguments of a call and reports what it stored in *result. Anything else
+// it returns means the call has to be made by the interpreter instead.
+enum class NativeResult : int { Int, Bool, Null };
+using NativeEntry = int (*)(const int* args, int* result);
+const size_t MAX_NATIVE_ARGS = 16;
+
+// calls and chunk belong to the tiered engine: calls counts interpreted calls until the body is compiled, and the
+// compiled chunk is published once, with a release store, so callers on every thread switch over to it. native
+// is published the same way by the JIT and is tried before either.
 struct FuncInfo {
-    vector<string> args;
+    SymbolId name;
+    ArenaSpan<SymbolId> args;
+    // Declared parameter types, checked on every call; empty when no parameter declares one
+    ArenaSpan<ValueType> arg_types;
     NodePtr block;
+    uint32_t frame_size;
+    mutable atomic<uint32_t> calls{ 0 };
+    mutable atomic<const Chunk*> chunk{ nullptr };
+    mutable atomic<NativeEntry> native{ nullptr };
+
+    FuncInfo(SymbolId name, ArenaSpan<SymbolId> args, ArenaSpan<ValueType> arg_types, NodePtr block, uint32_t frame_size)
+        : name(name), args(args), arg_types(arg_types), block(block), frame_size(frame_size) {}
+};
+
+// How the statement that just ran finished. Break, continue and return set it on the frame's table instead of
+// throwing; blocks stop at the first non-normal completion and loops and calls consume it. TailCall is a return
+// whose value is another call, which the caller makes on the same frame.
+enum class Completion : unsigned char { Normal, Break, Continue, Return, TailCall };
+
+struct Slot {
+    EvalResult value;
+    bool defined = false;
 };
 
+// One frame of variables. The resolver gives every variable a fixed slot in its function's frame (or in the global
+// frame for setup/main), so lookups are an index; a slot stays undefined until something is stored in it. The global
+// table owns its slots, function calls run on frames borrowed from the thread's FramePool and threadloops run on a
+// table of their own that views the global frame.
 class SymbolTable {
 private:
-    unordered_map<string, EvalResult> variables;
-    unordered_map<string, unordered_map<string, int>> enums;
-    unordered_map<string, vector<pair<string, string>>> struct_definitions;
-    unordered_map<string, unordered_map<string, EvalResult>> struct_instances;
+    vector<Slot> owned;
+    Slot* slots = nullptr;
+    unordered_map<SymbolId, unordered_map<SymbolId, int>> enums;
+    unordered_map<SymbolId, vector<pair<SymbolId, SymbolId>>> struct_definitions;
+    unordered_map<SymbolId, unordered_map<SymbolId, EvalResult>> struct_instances;
+    // The table whose enums and structs are used: this one, unless it is a view of another table's frame
+    SymbolTable* definitions = this;
 
 public:
-    void setVariable(const string& name, EvalResult value, bool declare = false) {
-        variables[name] = value;
+    Completion completion = Completion::Normal;
+    EvalResult return_value;
+    // Set along with Completion::TailCall: the call to make next and its already evaluated arguments
+    const FuncCallNode* tail_call = nullptr;
+    vector<EvalResult> tail_args;
+
+    SymbolTable() = default;
+    explicit SymbolTable(Slot* frame) : slots(frame) {}
+    // Shares the variables, enums and structs of another table but keeps its own completion, so a thread running on
+    // it cannot end or skip a loop in the thread that owns the frame
+    explicit SymbolTable(SymbolTable* shared) : slots(shared->slots), definitions(shared->definitions) {}
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    void resize(size_t slot_count) {
+        owned.resize(slot_count);
+        slots = owned.data();
+    }
+
+    // Points the table at the frame of a tail-called function, leaving it as a freshly created table would be
+    void reenter(Slot* frame) {
+        slots = frame;
+        completion = Completion::Normal;
+        tail_call = nullptr;
+        tail_args.clear();
+        enums.clear();
+        struct_definitions.clear();
+        struct_instances.clear();
+    }
+
+    void setVariable(uint32_t slot, EvalResult value) {
+        slots[slot].value = move(value);
+        slots[slot].defined = true;
     }
 
-    EvalResult getVariable(const string& name) {
-        auto it = variables.find(name);
-        if (it != variables.end()) { return it->second; }
-        else { throw invalid_argument("Undefined variable: " + name); }
+    // name is only used for the error message
+    const EvalResult& getVariable(uint32_t slot, SymbolId name) const {
+        if (!slots[slot].defined) { throw invalid_argument("Undefined variable: " + symbol_name(name)); }
+        return slots[slot].value;
     }
 
-    void setEnum(const string& name, const vector<string>& values) {
-        unordered_map<string, int> enumValues;
+    void setEnum(SymbolId name, const vector<SymbolId>& values) {
+        unordered_map<SymbolId, int> enumValues;
         for (size_t i = 0; i < values.size(); ++i) {
             enumValues[values[i]] = i;
         }
-        enums[name] = enumValues;
+        definitions->enums[name] = enumValues;
     }
     
-    int getEnumValue(const string& enumName, const string& valueName) {
-        auto it = enums.find(enumName);
-        if (it != enums.end() && it->second.find(valueName) != it->second.end()) {
+    int getEnumValue(SymbolId enumName, SymbolId valueName) {
+        auto it = definitions->enums.find(enumName);
+        if (it != definitions->enums.end() && it->second.find(valueName) != it->second.end()) {
             return it->second[valueName];
         } else {
-            throw invalid_argument("Undefined enum or value: " + enumName + "::" + valueName);
+            throw invalid_argument("Undefined enum or value: " + symbol_name(enumName) + "::" + symbol_name(valueName));
         }
     }
 
-    void define_struct(const string& name, const vector<pair<string, string>>& fields) {
-        struct_definitions[name] = fields;
+    void define_struct(SymbolId name, const vector<pair<SymbolId, SymbolId>>& fields) {
+        definitions->struct_definitions[name] = fields;
     }
 
-    void create_struct_instance(const string& instance_name, const string& struct_name) {
+    void create_struct_instance(SymbolId instance_name, SymbolId struct_name) {
+        auto& struct_definitions = definitions->struct_definitions;
+        auto& struct_instances = definitions->struct_instances;
         if (struct_definitions.find(struct_name) == struct_definitions.end()) {
-            throw runtime_error("Struct '" + struct_name + "' not defined.");
+            throw runtime_error("Struct '" + symbol_name(struct_name) + "' not defined.");
         }
-        struct_instances[instance_name] = unordered_map<string, EvalResult>();
+        struct_instances[instance_name] = unordered_map<SymbolId, EvalResult>();
         for (const auto& field : struct_definitions[struct_name]) {
-            struct_instances[instance_name][field.second] = {};
+            struct_instances[instance_name][field.second] = EvalResult(0);
         }
     }
 
-    unordered_map<string, EvalResult>* get_struct_instance(const string& instance_name) {
-        auto iter = struct_instances.find(instance_name);
-        if (iter != struct_instances.end()) {
+    unordered_map<SymbolId, EvalResult>* get_struct_instance(SymbolId instance_name) {
+        auto iter = definitions->struct_instances.find(instance_name);
+        if (iter != definitions->struct_instances.end()) {
             return &iter->second;
         }
         return nullptr;
     }
 };
 
+// A faster tier the tree-walker hands hot code to. The tree-walker counts calls and loop iterations itself and
+// asks for a chunk once a count reaches threshold, then runs that chunk on the frame it already set up.
+class Tiering {
+public:
+    const uint32_t threshold;
+
+    explicit Tiering(uint32_t threshold) : threshold(threshold) {}
+    virtual ~Tiering() = default;
+    virtual const Chunk* compile_function(const FuncInfo& function) = 0;
+    // The chunk of a while loop starts at its condition, so it can take over between two iterations
+    virtual const Chunk* compile_loop(const Node* loop) = 0;
+    virtual EvalResult execute(const Chunk& chunk, SymbolTable& symbol_table) = 0;
+};
+
+// Functions live in a deque so their index (and address) never changes once declared. Every change to any table
+// takes a fresh version from a process-wide counter, so a call site that cached (version, index) can tell whether
+// its entry is still current, and stamps from two different tables never match.
 class FuncTable {
 private:
-    unordered_map<string, FuncInfo> functions;
+    deque<FuncInfo> functions;
+    unordered_map<SymbolId, uint32_t> indexes;
+    atomic<uint32_t> current_version{ next_version() };
+
+    static uint32_t next_version() {
+        static atomic<uint32_t> counter{ 0 };
+        return ++counter;
+    }
 
 public:
-    void setFunction(const string& name, const vector<string>& args, const NodePtr& block) {
-        if (functions.find(name) != functions.end()) { throw invalid_argument("Function already declared: " + name); }
-        functions[name] = {args, block};
+    // Set when the tiered engine runs; null for the plain tree-walker and the VM
+    Tiering* tiering = nullptr;
+
+    void setFunction(SymbolId name, ArenaSpan<SymbolId> args, ArenaSpan<ValueType> arg_types, NodePtr block, uint32_t frame_size) {
+        if (indexes.find(name) != indexes.end()) { throw invalid_argument("Function already declared: " + symbol_name(name)); }
+        functions.emplace_back(name, args, arg_types, block, frame_size);
+        indexes[name] = functions.size() - 1;
+        current_version.store(next_version(), memory_order_release);
     }
 
-    FuncInfo getFunction(const string& name) {
-        auto it = functions.find(name);
-        if (it != functions.end()) { return it->second; } 
-        else { throw invalid_argument("Undefined function: " + name); }
+    uint32_t version() const { return current_version.load(memory_order_acquire); }
+
+    uint32_t indexOf(SymbolId name) const {
+        auto it = indexes.find(name);
+        if (it != indexes.end()) { return it->second; }
+        else { throw invalid_argument("Undefined function: " + symbol_name(name)); }
     }
+
+    const FuncInfo& at(uint32_t index) const { return functions[index]; }
+    size_t size() const { return functions.size(); }
+
+    const FuncInfo& getFunction(SymbolId name) const { return functions[indexOf(name)]; }
 };
\ No newline at end of file
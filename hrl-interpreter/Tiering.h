@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "Jit.h"
+#include "VM.h"
+using namespace std;
+
+// The tiered engine's top tier: hot functions and loops are compiled to bytecode and run by the VM. Chunks come
+// from the VM's cache, so a function compiled here is the same chunk the VM uses when compiled code calls it. With
+// a NativeJit attached, promoted functions are also handed to it and move on to native code once it is built.
+class BytecodeTier : public Tiering {
+private:
+    struct Promotion {
+        string name;
+        uint32_t instructions;
+    };
+
+    VM vm;
+    FuncTable& func_table;
+    string_view source;
+    mutex promotions_lock;
+    vector<Promotion> functions;
+    vector<Promotion> loops;
+    unordered_set<const FuncInfo*> promoted;
+
+    size_t line_of(uint32_t offset) const {
+        return count(source.begin(), source.begin() + min<size_t>(offset, source.size()), '\n') + 1;
+    }
+
+public:
+    NativeJit* jit = nullptr;
+
+    BytecodeTier(FuncTable& func_table, string_view source, uint32_t threshold)
+        : Tiering(threshold), vm(func_table), func_table(func_table), source(source) {}
+
+    const Chunk* compile_function(const FuncInfo& function) override {
+        const Chunk& chunk = vm.function_chunk(function);
+        lock_guard<mutex> guard(promotions_lock);
+        functions.push_back({ symbol_name(function.name), static_cast<uint32_t>(chunk.code.size()) });
+        promoted.insert(&function);
+        if (jit) { jit->request(function); }
+        return &chunk;
+    }
+
+    const Chunk* compile_loop(const Node* loop) override {
+        const Chunk& chunk = vm.loop_chunk_for(const_cast<NodePtr>(loop));
+        lock_guard<mutex> guard(promotions_lock);
+        loops.push_back({ "while at line " + to_string(line_of(static_cast<const WhileNode*>(loop)->offset)), static_cast<uint32_t>(chunk.code.size()) });
+        if (jit) { jit->request_calls(loop); }
+        return &chunk;
+    }
+
+    EvalResult execute(const Chunk& chunk, SymbolTable& symbol_table) override { return vm.execute(chunk, symbol_table); }
+
+    // Functions and loops in the order they were promoted, then every function still running in the tree-walker
+    void print_stats(ostream& out) {
+        lock_guard<mutex> guard(promotions_lock);
+        out << "Tier-up statistics (threshold " << threshold << ")" << endl;
+        out << "  Functions promoted to bytecode: " << functions.size() << endl;
+        for (const Promotion& function : functions) {
+            out << "    " << function.name << ": " << function.instructions << " instructions" << endl;
+        }
+        out << "  Loops promoted to bytecode: " << loops.size() << endl;
+        for (const Promotion& loop : loops) {
+            out << "    " << loop.name << ": " << loop.instructions << " instructions" << endl;
+        }
+        vector<string> called_from_bytecode, interpreted;
+        for (size_t i = 0; i < func_table.size(); ++i) {
+            const FuncInfo& function = func_table.at(i);
+            if (promoted.count(&function)) { continue; }
+            if (function.chunk.load(memory_order_acquire)) { called_from_bytecode.push_back(symbol_name(function.name)); }
+            else { interpreted.push_back(symbol_name(function.name) + ": " + to_string(function.calls.load(memory_order_relaxed)) + " calls"); }
+        }
+        out << "  Functions compiled when called from bytecode: " << called_from_bytecode.size() << endl;
+        for (const string& function : called_from_bytecode) { out << "    " << function << endl; }
+        out << "  Functions still interpreted: " << interpreted.size() << endl;
+        for (const string& function : interpreted) { out << "    " << function << endl; }
+        if (jit) { jit->print_stats(out); }
+    }
+};
@@ -1,173 +1,345 @@
+#include <charconv>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <cctype>
-#include <unordered_map>
+#include <cstring>
 #include <stdexcept>
+#include <system_error>
+#include <algorithm>
+#include <omp.h>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "Scanner.h"
+#include "Interner.h"
 using namespace std;
 
+enum class TokenType : unsigned char {
+    SETUP, MAIN, ENUM, STRUCT, BEHAVIOR, WHILE, IF, ELSE, SWITCH, CASE, CONST, FUNCTION, THREADLOOP, BREAK, CONTINUE, RETURN,
+    EQ, NEQ, LT, LE, GT, GE, COLON, COMMA, ASSIGN, SEMICOLON, LBRACE, RBRACE, LPAREN, RPAREN, DOT, LBRACKET, RBRACKET,
+    PLUS, MINUS, MULT, DIV, MOD, AND, OR, NOT, CONCAT,
+    IDENTIFIER, NUMBER_LITERAL, STRING_LITERAL, END_OF_FILE
+};
+
+constexpr string_view tokenTypeName(TokenType type) {
+    constexpr string_view names[] = {
+        "SETUP", "MAIN", "ENUM", "STRUCT", "BEHAVIOR", "WHILE", "IF", "ELSE", "SWITCH", "CASE", "CONST", "FUNCTION", "THREADLOOP", "BREAK", "CONTINUE", "RETURN",
+        "EQ", "NEQ", "LT", "LE", "GT", "GE", "COLON", "COMMA", "ASSIGN", "SEMICOLON", "LBRACE", "RBRACE", "LPAREN", "RPAREN", "DOT", "LBRACKET", "RBRACKET",
+        "PLUS", "MINUS", "MULT", "DIV", "MOD", "AND", "OR", "NOT", "CONCAT",
+        "IDENTIFIER", "NUMBER_LITERAL", "STRING_LITERAL", "EOF"
+    };
+    return names[static_cast<size_t>(type)];
+}
+
+// Keyword recognition switches on word length and then on the first character, so at most one string compare is made
+constexpr TokenType lookupKeyword(string_view word) {
+    switch (word.size()) {
+        case 2:
+            if (word == "if") { return TokenType::IF; }
+            break;
+        case 4:
+            if (word[0] == 'm' && word == "main") { return TokenType::MAIN; }
+            if (word[0] == 'e' && word == "enum") { return TokenType::ENUM; }
+            if (word[0] == 'e' && word == "else") { return TokenType::ELSE; }
+            if (word[0] == 'c' && word == "case") { return TokenType::CASE; }
+            break;
+        case 5:
+            if (word[0] == 's' && word == "setup") { return TokenType::SETUP; }
+            if (word[0] == 'w' && word == "while") { return TokenType::WHILE; }
+            if (word[0] == 'c' && word == "const") { return TokenType::CONST; }
+            if (word[0] == 'b' && word == "break") { return TokenType::BREAK; }
+            break;
+        case 6:
+            if (word[0] == 's' && word == "struct") { return TokenType::STRUCT; }
+            if (word[0] == 's' && word == "switch") { return TokenType::SWITCH; }
+            if (word[0] == 'r' && word == "return") { return TokenType::RETURN; }
+            break;
+        case 8:
+            if (word[0] == 'b' && word == "behavior") { return TokenType::BEHAVIOR; }
+            if (word[0] == 'f' && word == "function") { return TokenType::FUNCTION; }
+            if (word[0] == 'c' && word == "continue") { return TokenType::CONTINUE; }
+            break;
+        case 10:
+            if (word == "threadloop") { return TokenType::THREADLOOP; }
+            break;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+static_assert(lookupKeyword("threadloop") == TokenType::THREADLOOP && lookupKeyword("mains") == TokenType::IDENTIFIER);
+
+// Value of a NUMBER_LITERAL token: literals with a decimal point are doubles, the rest ints
+struct NumberLiteral {
+    bool is_double = false;
+    int int_value = 0;
+    double double_value = 0;
+};
+
 class Token {
 public:
-    string type;
-    int value;
-    string valueString;
+    TokenType type;
+    NumberLiteral number;
+    string_view valueString;
+};
+
+// Whole-file token stream in struct-of-arrays form. Token i spans text [offsets[i], offsets[i] + lengths[i]) of
+// source (string literals exclude their quotes); literals[i] indexes numbers for NUMBER_LITERAL, is the interned
+// SymbolId for IDENTIFIER and is -1 otherwise.
+struct TokenBuffer {
+    string_view source;
+    vector<TokenType> kinds;
+    vector<uint32_t> offsets;
+    vector<uint32_t> lengths;
+    vector<int32_t> literals;
+    vector<NumberLiteral> numbers;
+    unordered_map<string_view, SymbolId> seen;
+
+    size_t size() const { return kinds.size(); }
+    string_view text(size_t index) const { return source.substr(offsets[index], lengths[index]); }
+
+    void reserve(size_t count) {
+        kinds.reserve(count);
+        offsets.reserve(count);
+        lengths.reserve(count);
+        literals.reserve(count);
+    }
+
+    // Appends another buffer lexed from the same source, rebasing its literal indexes
+    void append(const TokenBuffer& other) {
+        int32_t base = numbers.size();
+        kinds.insert(kinds.end(), other.kinds.begin(), other.kinds.end());
+        offsets.insert(offsets.end(), other.offsets.begin(), other.offsets.end());
+        lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.end());
+        for (size_t i = 0; i < other.size(); ++i) {
+            literals.push_back(other.kinds[i] == TokenType::NUMBER_LITERAL ? other.literals[i] + base : other.literals[i]);
+        }
+        numbers.insert(numbers.end(), other.numbers.begin(), other.numbers.end());
+    }
+
+    void push(const Token& token) {
+        int32_t literal = -1;
+        if (token.type == TokenType::NUMBER_LITERAL) {
+            literal = numbers.size();
+            numbers.push_back(token.number);
+        } else if (token.type == TokenType::IDENTIFIER) {
+            // The per-buffer cache keeps parallel chunks from contending on the global interner for repeated names
+            auto it = seen.find(token.valueString);
+            if (it == seen.end()) { it = seen.emplace(token.valueString, intern(token.valueString)).first; }
+            literal = it->second;
+        }
+        kinds.push_back(token.type);
+        offsets.push_back(token.valueString.data() - source.data());
+        lengths.push_back(token.valueString.size());
+        literals.push_back(literal);
+    }
 };
 
 class Tokenizer {
 private:
-    string source;
+    string_view source;
     size_t position;
     Token next;
+    const ScanKernels* scanner;
 
-public:
-    unordered_map<string, string> keywordMap;
-    Tokenizer(string src) : source(src), position(0), next({ "", 0 }) {
-        keywordMap["setup"] = "SETUP";
-        keywordMap["main"] = "MAIN";
-        keywordMap["enum"] = "ENUM";
-        keywordMap["struct"] = "STRUCT";
-        keywordMap["behavior"] = "BEHAVIOR";
-        keywordMap["while"] = "WHILE";
-        keywordMap["if"] = "IF";
-        keywordMap["else"] = "ELSE";
-        keywordMap["switch"] = "SWITCH";
-        keywordMap["case"] = "CASE";
-        keywordMap["const"] = "CONST";
-        keywordMap["function"] = "FUNCTION";
-        keywordMap["threadloop"] = "THREADLOOP";
-        keywordMap["break"] = "BREAK";
-        keywordMap["continue"] = "CONTINUE";
-        keywordMap["return"] = "RETURN";
-        keywordMap["=="] = "EQ";
-        keywordMap["!="] = "NEQ";
-        keywordMap["<"] = "LT";
-        keywordMap["<="] = "LE";
-        keywordMap[">"] = "GT";
-        keywordMap[">="] = "GE";
-        keywordMap[":"] = "COLON";
-        keywordMap[","] = "COMMA";
-        keywordMap["="] = "ASSIGN";
-        keywordMap[";"] = "SEMICOLON";
-        keywordMap["{"] = "LBRACE";
-        keywordMap["}"] = "RBRACE";
-        keywordMap["("] = "LPAREN";
-        keywordMap[")"] = "RPAREN";
-        keywordMap["."] = "DOT";
-        keywordMap["["] = "LBRACKET";
-        keywordMap["]"] = "RBRACKET";
-        keywordMap["+"] = "PLUS";
-        keywordMap["-"] = "MINUS";
-        keywordMap["*"] = "MULT";
-        keywordMap["/"] = "DIV";
-        keywordMap["%"] = "MOD";
-        keywordMap["&&"] = "AND";
-        keywordMap["||"] = "OR";
-        keywordMap["!"] = "NOT";
-        keywordMap[".."] = "CONCAT";
+    // Skips whitespace, blank lines and '--' comments in place, so the source never has to be copied
+    void skipWhitespaceAndComments() {
+        const char* begin = source.data();
+        const char* end = begin + source.size();
+        while (true) {
+            position = scanner->skip_whitespace(begin + position, end) - begin;
+            if (position + 1 < source.size() && source[position] == '-' && source[position + 1] == '-') {
+                const void* eol = memchr(begin + position + 2, '\n', source.size() - position - 2);
+                position = eol ? static_cast<const char*>(eol) - begin + 1 : source.size();
+            } else {
+                return;
+            }
+        }
     }
 
+    // Consumes a one- or two-character operator starting at current_char, which has already been read
+    TokenType scanOperator(char current_char) {
+        char following = position < source.size() ? source[position] : '\0';
+        auto pair = [&](TokenType type) { position++; return type; };
+        switch (current_char) {
+            case '=': return following == '=' ? pair(TokenType::EQ) : TokenType::ASSIGN;
+            case '!': return following == '=' ? pair(TokenType::NEQ) : TokenType::NOT;
+            case '<': return following == '=' ? pair(TokenType::LE) : TokenType::LT;
+            case '>': return following == '=' ? pair(TokenType::GE) : TokenType::GT;
+            case '.': return following == '.' ? pair(TokenType::CONCAT) : TokenType::DOT;
+            case '&': if (following == '&') { return pair(TokenType::AND); } break;
+            case '|': if (following == '|') { return pair(TokenType::OR); } break;
+            case ':': return TokenType::COLON;
+            case ',': return TokenType::COMMA;
+            case ';': return TokenType::SEMICOLON;
+            case '{': return TokenType::LBRACE;
+            case '}': return TokenType::RBRACE;
+            case '(': return TokenType::LPAREN;
+            case ')': return TokenType::RPAREN;
+            case '[': return TokenType::LBRACKET;
+            case ']': return TokenType::RBRACKET;
+            case '+': return TokenType::PLUS;
+            case '-': return TokenType::MINUS;
+            case '*': return TokenType::MULT;
+            case '/': return TokenType::DIV;
+            case '%': return TokenType::MOD;
+        }
+        throw invalid_argument("Invalid operator: '" + string(1, current_char) + "'");
+    }
+
+public:
+    // Scans with the widest kernel set the CPU supports unless another set is given (the scanner benchmark does)
+    Tokenizer(string_view src, const ScanKernels& kernels = scan::kernels()) : source(src), position(0), next({ TokenType::END_OF_FILE, {} }), scanner(&kernels) {}
+
     void updateNextToken() {
         if (source.empty()) {
             throw invalid_argument("Empty Input");
         }
-        while (position < source.size()) {
+        skipWhitespaceAndComments();
+        if (position < source.size()) {
             char current_char = source[position];
-            if (isspace(current_char)) {
-                position++;
-            } else if (isdigit(current_char) || current_char == '.') {
-                next.type = "NUMBER_LITERAL";
-                next.valueString = "";
-                bool hasDecimal = (current_char == '.');
-                if (!hasDecimal) {
-                    next.valueString += current_char;
-                    position++;
-                    while (position < source.size() && (isdigit(source[position]) || source[position] == '.')) {
-                        if (source[position] == '.' && !hasDecimal) {
-                            hasDecimal = true;
-                        } else if (source[position] == '.' && hasDecimal) {
-                            throw invalid_argument("Invalid floating-point literal: " + next.valueString + source[position]);
-                        }
-                        next.valueString += source[position];
-                        position++;
-                    }
-                    next.value = stoi(next.valueString);
-                } else {
-                    next.valueString = ".";
-                    position++;
-                    while (position < source.size() && isdigit(source[position])) {
-                        next.valueString += source[position];
-                        position++;
-                    }
-                    if (next.valueString == ".") {
-                        throw invalid_argument("Invalid floating-point literal: " + next.valueString);
+            bool leadingDot = current_char == '.' && position + 1 < source.size() && isdigit(source[position + 1]);
+            size_t start = position;
+            if (isdigit(current_char) || leadingDot) {
+                next.type = TokenType::NUMBER_LITERAL;
+                const char* begin = source.data();
+                const char* end = begin + source.size();
+                bool hasDecimal = false;
+                position = scanner->scan_digits(begin + position, end) - begin;
+                while (position < source.size() && source[position] == '.') {
+                    if (position + 1 < source.size() && source[position + 1] == '.') { break; }
+                    if (hasDecimal) {
+                        throw invalid_argument("Invalid floating-point literal: " + string(source.substr(start, position - start + 1)));
                     }
-                    next.value = stod(next.valueString);
+                    hasDecimal = true;
+                    position = scanner->scan_digits(begin + position + 1, end) - begin;
                 }
+                next.valueString = source.substr(start, position - start);
+                next.number = parseNumber(next.valueString, hasDecimal);
                 return;
             } else if (isalpha(current_char) || current_char == '_') {
-                string identifier = "";
-                identifier += current_char;
-                position++;
-                while (position < source.size() && (isalnum(source[position]) || source[position] == '_')) {
-                    identifier += source[position];
-                    position++;
-                }
-                if (keywordMap.find(identifier) != keywordMap.end()) {
-                    next.type = keywordMap[identifier];
-                } else {
-                    next.type = "IDENTIFIER";
-                    next.valueString = identifier;
-                }
+                position = scanner->scan_identifier(source.data() + position + 1, source.data() + source.size()) - source.data();
+                next.valueString = source.substr(start, position - start);
+                next.type = lookupKeyword(next.valueString);
                 return;
             } else if (current_char == '"') {
-                next.type = "STRING_LITERAL";
-                next.valueString = "";
+                next.type = TokenType::STRING_LITERAL;
+                const char* begin = source.data();
+                const char* end = begin + source.size();
                 position++;
-                while (position < source.size() && source[position] != '"') {
-                    if (source[position] == '\\' && position + 1 < source.size() && source[position + 1] == '"') {
-                        next.valueString += '"';
-                        position += 2;
-                    } else {
-                        next.valueString += source[position];
-                        position++;
-                    }
+                while (true) {
+                    position = scanner->scan_string(begin + position, end) - begin;
+                    if (position >= source.size() || source[position] == '"') { break; }
+                    position += (position + 1 < source.size() && source[position + 1] == '"') ? 2 : 1;
                 }
-                if (position >= source.size() || source[position] != '"') {
+                if (position >= source.size()) {
                     throw invalid_argument("Unterminated string");
                 }
+                next.valueString = source.substr(start + 1, position - start - 1);
                 position++;
                 return;
             } else {
-                string identifier = "";
-                identifier += current_char;
                 position++;
-                if ((current_char == '=' || current_char == '!' || current_char == '<' || current_char == '>') &&
-                    position < source.size() && source[position] == '=') {
-                    identifier += source[position];
-                    position++;
-                } else if (current_char == '&' && position < source.size() && source[position] == '&') {
-                    identifier += source[position];
-                    position++;
-                } else if (current_char == '|' && position < source.size() && source[position] == '|') {
-                    identifier += source[position];
-                    position++;
-                } else if (current_char == '.' && position < source.size() && source[position] == '.') {
-                    identifier += source[position];
-                    position++;
-                }
-                if (keywordMap.find(identifier) != keywordMap.end()) {
-                    next.type = keywordMap[identifier];
-                } else {
-                    throw invalid_argument("Invalid operator: '" + identifier + "'");
-                }
+                next.type = scanOperator(current_char);
+                next.valueString = source.substr(start, position - start);
                 return;
             }
         }
-        next.type = "EOF";
-        next.value = 0;
+        next.type = TokenType::END_OF_FILE;
+        next.number = {};
+        next.valueString = source.substr(source.size());
+    }
+
+    // from_chars reads the digits straight from the source, without the copy and locale lookup of stoi and stod
+    static NumberLiteral parseNumber(string_view text, bool is_double) {
+        NumberLiteral number;
+        number.is_double = is_double;
+        const char* end = text.data() + text.size();
+        from_chars_result result = is_double ? from_chars(text.data(), end, number.double_value) : from_chars(text.data(), end, number.int_value);
+        if (result.ec == errc::result_out_of_range) { throw invalid_argument("Number literal out of range: " + string(text)); }
+        if (result.ec != errc() || result.ptr != end) { throw invalid_argument("Invalid number literal: " + string(text)); }
+        return number;
+    }
+
+    // String literal tokens are raw slices of the source; escaped quotes are resolved only when a literal node is built
+    static string unescape(string_view raw) {
+        string value;
+        value.reserve(raw.size());
+        for (size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] == '\\' && i + 1 < raw.size() && raw[i + 1] == '"') { value += '"'; ++i; }
+            else { value += raw[i]; }
+        }
+        return value;
     }
 
     Token selectNext() {
         updateNextToken();
         return next;
     }
+
+    // Lexes everything from the current position into tokens, ending with a single END_OF_FILE token
+    void tokenize(TokenBuffer& tokens) {
+        tokens.source = source;
+        tokens.reserve(source.size() / 8);
+        do {
+            updateNextToken();
+            tokens.push(next);
+        } while (next.type != TokenType::END_OF_FILE);
+    }
+
+    // Lexes the tokens that start in [begin, limit) and returns the offset just past the last one, which lies
+    // beyond limit when a string literal runs across it. No END_OF_FILE token is appended.
+    size_t tokenizeRange(TokenBuffer& tokens, size_t begin, size_t limit) {
+        if (source.empty()) {
+            throw invalid_argument("Empty Input");
+        }
+        tokens.source = source;
+        tokens.reserve((limit - begin) / 8);
+        position = begin;
+        size_t last_end = begin;
+        while (true) {
+            skipWhitespaceAndComments();
+            if (position >= limit) { break; }
+            updateNextToken();
+            tokens.push(next);
+            last_end = position;
+        }
+        return last_end;
+    }
+
+    // Splits large sources after newlines and lexes the chunks in parallel. A chunk is only kept if the previous
+    // chunk's last token ended before it starts; otherwise its start was inside a string literal, and it is
+    // re-lexed from where the previous token really ended.
+    static void tokenizeParallel(string_view source, TokenBuffer& tokens, size_t min_chunk_size = 1 << 20) {
+        size_t chunk_count = min<size_t>(omp_get_max_threads(), source.size() / min_chunk_size);
+        if (chunk_count <= 1) {
+            Tokenizer(source).tokenize(tokens);
+            return;
+        }
+        vector<size_t> starts(chunk_count + 1, source.size());
+        starts[0] = 0;
+        for (size_t i = 1; i < chunk_count; ++i) {
+            size_t eol = source.find('\n', max(starts[i - 1], i * source.size() / chunk_count));
+            starts[i] = (eol == string_view::npos) ? source.size() : eol + 1;
+        }
+        vector<TokenBuffer> chunks(chunk_count);
+        vector<size_t> ends(chunk_count, 0);
+        vector<char> failed(chunk_count, false);
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t i = 0; i < chunk_count; ++i) {
+            try { ends[i] = Tokenizer(source).tokenizeRange(chunks[i], starts[i], starts[i + 1]); }
+            catch (...) { failed[i] = true; }
+        }
+        tokens.source = source;
+        size_t previous_end = 0;
+        for (size_t i = 0; i < chunk_count; ++i) {
+            if (failed[i] || previous_end > starts[i]) {
+                chunks[i] = TokenBuffer();
+                ends[i] = Tokenizer(source).tokenizeRange(chunks[i], min(previous_end, starts[i + 1]), starts[i + 1]);
+            }
+            previous_end = max({ previous_end, ends[i], starts[i] });
+            tokens.append(chunks[i]);
+        }
+        tokens.push({ TokenType::END_OF_FILE, {}, source.substr(source.size()) });
+    }
 };
@@ -0,0 +1,497 @@
+#pragma once
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Turns the AST produced by Parser::run into a standalone C++ translation unit built on Runtime.h. Variables
+// become C++ locals (or globals, for the setup/main frame) named after their resolver slot, control flow maps onto
+// C++ control flow, and values and operators go through the same Value and ops code as the interpreter. A return
+// of a call to the function it is in becomes a jump back to the top of that function.
+class Transpiler {
+private:
+    // What a break, continue or return outside of any loop ends
+    enum class Body { TopLevel, Function, ThreadLoop };
+
+    struct Frame {
+        map<uint32_t, SymbolId> slots;
+        bool uses_enums = false;
+        bool self_tail_call = false;
+    };
+
+    ostringstream out;
+    string source_name;
+    unordered_map<SymbolId, const FuncDeclareNode*> functions;
+    vector<const FuncDeclareNode*> function_order;
+    // Functions that can return a pending tail call to another function, whose callers have to settle() it
+    set<SymbolId> trampolined;
+    set<SymbolId> tail_targets;
+    set<string> natives;
+    vector<string> constants;
+    unordered_map<string, size_t> constant_ids;
+
+    Body body = Body::TopLevel;
+    int loops = 0;
+    int depth = 0;
+    const FuncDeclareNode* current_function = nullptr;
+    bool global_frame = false;
+    // Name of every slot of the frame being emitted
+    map<uint32_t, SymbolId> current_slots;
+
+    // Calls f on node and everything below it. Function bodies are only entered when enter_functions is set, since
+    // they are separate frames.
+    template <typename F>
+    static void visit(NodePtr node, bool enter_functions, F&& f) {
+        if (!node) { return; }
+        f(node);
+        auto each = [&](NodeList nodes) { for (NodePtr child : nodes) { visit(child, enter_functions, f); } };
+        switch (node->kind) {
+            case NodeKind::BinOp:
+                visit(static_cast<BinOpNode*>(node)->left, enter_functions, f);
+                visit(static_cast<BinOpNode*>(node)->right, enter_functions, f);
+                break;
+            case NodeKind::UnOp: visit(static_cast<UnOpNode*>(node)->child, enter_functions, f); break;
+            case NodeKind::VarDeclare: visit(static_cast<VarDeclareNode*>(node)->expression, enter_functions, f); break;
+            case NodeKind::Assignment: visit(static_cast<AssignmentNode*>(node)->expression, enter_functions, f); break;
+            case NodeKind::While:
+                visit(static_cast<WhileNode*>(node)->condition, enter_functions, f);
+                visit(static_cast<WhileNode*>(node)->block, enter_functions, f);
+                break;
+            case NodeKind::If:
+                visit(static_cast<IfNode*>(node)->condition, enter_functions, f);
+                visit(static_cast<IfNode*>(node)->block, enter_functions, f);
+                visit(static_cast<IfNode*>(node)->else_block, enter_functions, f);
+                break;
+            case NodeKind::FuncDeclare:
+                if (enter_functions) { visit(static_cast<FuncDeclareNode*>(node)->block_node, enter_functions, f); }
+                break;
+            case NodeKind::FuncCall: each(static_cast<FuncCallNode*>(node)->args); break;
+            case NodeKind::Return: visit(static_cast<ReturnNode*>(node)->return_node, enter_functions, f); break;
+            case NodeKind::Block: each(static_cast<BlockNode*>(node)->statements); break;
+            case NodeKind::Program:
+                visit(static_cast<ProgramNode*>(node)->setup_block, enter_functions, f);
+                visit(static_cast<ProgramNode*>(node)->main_block, enter_functions, f);
+                break;
+            case NodeKind::Array: each(static_cast<ArrayNode*>(node)->nodes); break;
+            case NodeKind::ArrayAccess: visit(static_cast<ArrayAccessNode*>(node)->index, enter_functions, f); break;
+            case NodeKind::ThreadLoop: visit(static_cast<ThreadLoopNode*>(node)->block, enter_functions, f); break;
+            default: break;
+        }
+    }
+
+    // Slot names and features of the frame rooted at node (a function body, or setup and main together)
+    Frame scan_frame(NodePtr node, const FuncDeclareNode* function) {
+        Frame frame;
+        if (function) {
+            for (size_t i = 0; i < function->args.size(); ++i) { frame.slots[i] = function->args[i]; }
+        }
+        visit(node, false, [&](NodePtr child) {
+            switch (child->kind) {
+                case NodeKind::Var: frame.slots.emplace(static_cast<VarNode*>(child)->slot, static_cast<VarNode*>(child)->identifier); break;
+                case NodeKind::VarDeclare: frame.slots.emplace(static_cast<VarDeclareNode*>(child)->slot, static_cast<VarDeclareNode*>(child)->identifier); break;
+                case NodeKind::Assignment: frame.slots.emplace(static_cast<AssignmentNode*>(child)->slot, static_cast<AssignmentNode*>(child)->identifier); break;
+                case NodeKind::ArrayAccess: frame.slots.emplace(static_cast<ArrayAccessNode*>(child)->slot, static_cast<ArrayAccessNode*>(child)->identifier); break;
+                case NodeKind::Enum:
+                case NodeKind::EnumVal: frame.uses_enums = true; break;
+                case NodeKind::Return: frame.self_tail_call |= function && is_self_tail_call(static_cast<ReturnNode*>(child), function); break;
+                default: break;
+            }
+        });
+        return frame;
+    }
+
+    bool is_self_tail_call(const ReturnNode* ret, const FuncDeclareNode* function) const {
+        if (!ret->tail_call) { return false; }
+        auto call = static_cast<const FuncCallNode*>(ret->return_node);
+        return call->identifier == function->func_name && call->args.size() == function->args.size();
+    }
+
+    // A tail call to a different function that hrlc can bind
+    const FuncDeclareNode* other_tail_target(const ReturnNode* ret, const FuncDeclareNode* function) const {
+        if (!ret->tail_call || is_self_tail_call(ret, function)) { return nullptr; }
+        auto call = static_cast<const FuncCallNode*>(ret->return_node);
+        auto it = functions.find(call->identifier);
+        if (it == functions.end() || it->second->args.size() != call->args.size()) { return nullptr; }
+        return it->second;
+    }
+
+    static string variable(uint32_t slot, SymbolId name) { return "v" + to_string(slot) + "_" + symbol_name(name); }
+    static string declared(SymbolId function) { return "fn_" + symbol_name(function) + "_declared"; }
+    static string parameters(size_t arity) { return arity ? "array<Value, " + to_string(arity) + "> args" : ""; }
+    static string quoted(const string& text) { return "\"" + text + "\""; }
+
+    // Escapes every byte that is not printable ASCII as a three-digit octal escape, which cannot run into the
+    // characters after it
+    static string literal(const string& text) {
+        string result = "\"";
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') { result += '\\'; result += c; }
+            else if (c >= 32 && c < 127) { result += c; }
+            else {
+                char escape[5];
+                snprintf(escape, sizeof(escape), "\\%03o", c);
+                result += escape;
+            }
+        }
+        return result + "\"";
+    }
+
+    static string int_literal(int value) {
+        if (value == INT_MIN) { return "(-2147483647 - 1)"; }
+        return to_string(value);
+    }
+
+    // Hexadecimal literals round-trip exactly; folding can also leave an infinity or NaN behind
+    static string double_literal(double value) {
+        if (isnan(value)) { return "numeric_limits<double>::quiet_NaN()"; }
+        if (isinf(value)) { return value > 0 ? "numeric_limits<double>::infinity()" : "-numeric_limits<double>::infinity()"; }
+        char text[32];
+        snprintf(text, sizeof(text), "%a", value);
+        return text;
+    }
+
+    static const char* binop_name(BinOp op) {
+        static const char* names[] = { "Add", "Sub", "Mul", "Div", "Mod", "Eq", "Ne", "Lt", "Le", "Gt", "Ge", "And", "Or", "Concat" };
+        return names[static_cast<int>(op)];
+    }
+
+    static const char* unop_name(UnOp op) {
+        static const char* names[] = { "Plus", "Neg", "Not" };
+        return names[static_cast<int>(op)];
+    }
+
+    static string value_type(ValueType type) {
+        static const char* names[] = { "Null", "Int", "Double", "Bool", "String", "IntArray", "DoubleArray", "BoolArray", "StringArray" };
+        return string("ValueType::") + names[static_cast<int>(type)];
+    }
+
+    // Stores the type checker marked as checked, and arguments for parameters with a declared type
+    static string checked(const string& value, ValueType type, SymbolId name) {
+        if (type == ValueType::Null) { return value; }
+        return "hrl::checked(" + value + ", " + value_type(type) + ", " + quoted(symbol_name(name)) + ")";
+    }
+
+    static string argument(const string& value, const FuncDeclareNode* function, size_t index) {
+        if (index >= function->arg_types.size() || function->arg_types[index] == ValueType::Null) { return value; }
+        return "hrl::argument(" + value + ", " + value_type(function->arg_types[index]) + ", " + quoted(symbol_name(function->args[index])) + ")";
+    }
+
+    // String literals are built once, as globals, instead of every time they are evaluated
+    string constant(const string& text) {
+        auto it = constant_ids.find(text);
+        if (it != constant_ids.end()) { return "k" + to_string(it->second); }
+        constant_ids.emplace(text, constants.size());
+        constants.push_back(text);
+        return "k" + to_string(constants.size() - 1);
+    }
+
+    void line(const string& text) { out << string(depth * 4, ' ') << text << "\n"; }
+
+    string list(NodeList nodes) {
+        string result;
+        for (size_t i = 0; i < nodes.size(); ++i) { result += (i ? ", " : "") + expression(nodes[i]); }
+        return result;
+    }
+
+    string call(const FuncCallNode* call) {
+        string name = symbol_name(call->identifier);
+        if (call->builtin) {
+            natives.insert(name);
+            return "hrl::call(native_" + name + ", { " + list(call->args) + " })";
+        }
+        auto it = functions.find(call->identifier);
+        if (it == functions.end()) {
+            cerr << "hrlc: warning: call to undefined function " << name << endl;
+            return "hrl::undefined_function(" + quoted(name) + ")";
+        }
+        const FuncDeclareNode* function = it->second;
+        // Like FuncCallNode, the function is looked up before its arguments are evaluated
+        string check = "hrl::check_declared(" + declared(call->identifier) + ", " + quoted(name) + ")";
+        if (function->args.size() != call->args.size()) {
+            cerr << "hrlc: warning: function " << name << " called with " << call->args.size() << " arguments" << endl;
+            return "(" + check + ", hrl::wrong_arity(" + quoted(name) + ", " + to_string(function->args.size()) + ", " + to_string(call->args.size()) + "))";
+        }
+        string direct = "fn_" + name + (call->args.size() ? "({ " + list(call->args) + " })" : "()");
+        if (trampolined.count(call->identifier)) { direct = "hrl::settle(" + direct + ")"; }
+        return "(" + check + ", " + direct + ")";
+    }
+
+    string expression(NodePtr node) {
+        switch (node->kind) {
+            case NodeKind::IntVal: return "Value(" + int_literal(static_cast<IntValNode*>(node)->value) + ")";
+            case NodeKind::DoubleVal: return "Value(" + double_literal(static_cast<DoubleValNode*>(node)->value) + ")";
+            case NodeKind::StringVal: return constant(static_cast<StringValNode*>(node)->value);
+            case NodeKind::NoOp: return "Value()";
+            case NodeKind::Var: {
+                auto var = static_cast<VarNode*>(node);
+                return variable(var->slot, var->identifier) + ".get(" + quoted(symbol_name(var->identifier)) + ")";
+            }
+            case NodeKind::BinOp: {
+                auto binop = static_cast<BinOpNode*>(node);
+                return string("hrl::binop<BinOp::") + binop_name(binop->op) + ">({ " + expression(binop->left) + ", " + expression(binop->right) + " })";
+            }
+            case NodeKind::UnOp: {
+                auto unop = static_cast<UnOpNode*>(node);
+                return string("ops::unary(UnOp::") + unop_name(unop->op) + ", " + expression(unop->child) + ")";
+            }
+            case NodeKind::FuncCall: return call(static_cast<FuncCallNode*>(node));
+            case NodeKind::EnumVal: {
+                auto value = static_cast<EnumValNode*>(node);
+                return "Value(enums.get(" + quoted(symbol_name(value->enumName)) + ", " + quoted(symbol_name(value->valueName)) + "))";
+            }
+            case NodeKind::StructField: {
+                auto field = static_cast<StructFieldNode*>(node);
+                return "hrl::struct_field(" + quoted(symbol_name(field->struct_instance_name)) + ", " + quoted(symbol_name(field->field_name)) + ")";
+            }
+            case NodeKind::Array: return "ops::build_array({ " + list(static_cast<ArrayNode*>(node)->nodes) + " })";
+            case NodeKind::ArrayAccess: {
+                auto access = static_cast<ArrayAccessNode*>(node);
+                string array = variable(access->slot, access->identifier) + ".get(" + quoted(symbol_name(access->identifier)) + ")";
+                return "hrl::element({ " + array + ", " + expression(access->index) + " })";
+            }
+            default: throw invalid_argument("hrlc: cannot compile this node as an expression");
+        }
+    }
+
+    // How a break, continue or return ends the body it is in when no loop encloses it
+    string end_body() const { return body == Body::Function ? "return Value();" : "return;"; }
+
+    void statement(NodePtr node) {
+        switch (node->kind) {
+            case NodeKind::NoOp: break;
+            case NodeKind::FuncDeclare: {
+                SymbolId name = static_cast<FuncDeclareNode*>(node)->func_name;
+                line("hrl::declare_function(" + declared(name) + ", " + quoted(symbol_name(name)) + ");");
+                break;
+            }
+            case NodeKind::Block:
+                for (NodePtr child : static_cast<BlockNode*>(node)->statements) { statement(child); }
+                break;
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                string value = declare->expression ? expression(declare->expression) : declare->declared == ValueType::Null ? "Value(0)" : "ops::zero(" + value_type(declare->declared) + ")";
+                value = checked(value, declare->checked, declare->identifier);
+                string name = variable(declare->slot, declare->identifier);
+                string label = quoted(symbol_name(declare->identifier));
+                if (global_frame) { line("hrl::declare(" + name + ", " + value + ", " + label + ");"); }
+                else { line(name + ".set(" + value + ", " + label + ");"); }
+                break;
+            }
+            case NodeKind::Assignment: {
+                auto assignment = static_cast<AssignmentNode*>(node);
+                string value = checked(expression(assignment->expression), assignment->checked, assignment->identifier);
+                line(variable(assignment->slot, assignment->identifier) + ".set(" + value + ", " + quoted(symbol_name(assignment->identifier)) + ");");
+                break;
+            }
+            case NodeKind::While: {
+                auto loop = static_cast<WhileNode*>(node);
+                line("while (" + expression(loop->condition) + ".as_bool()) {");
+                ++depth;
+                ++loops;
+                statement(loop->block);
+                --loops;
+                --depth;
+                line("}");
+                break;
+            }
+            case NodeKind::If: {
+                auto branch = static_cast<IfNode*>(node);
+                line("if (" + expression(branch->condition) + ".as_bool()) {");
+                ++depth;
+                statement(branch->block);
+                --depth;
+                if (branch->else_block && branch->else_block->kind != NodeKind::NoOp) {
+                    line("}");
+                    line("else {");
+                    ++depth;
+                    statement(branch->else_block);
+                    --depth;
+                }
+                line("}");
+                break;
+            }
+            case NodeKind::Return: {
+                auto ret = static_cast<ReturnNode*>(node);
+                if (body != Body::Function) {
+                    line(expression(ret->return_node) + ";");
+                    line("return;");
+                }
+                else if (is_self_tail_call(ret, current_function)) { tail_call(static_cast<FuncCallNode*>(ret->return_node)); }
+                else if (const FuncDeclareNode* target = other_tail_target(ret, current_function)) {
+                    // As in the interpreter, the arguments are evaluated before the callee is looked up
+                    auto call = static_cast<FuncCallNode*>(ret->return_node);
+                    line("return hrl::tail_call(&tc_" + symbol_name(target->func_name) + ", array<Value, " + to_string(call->args.size()) + ">{ " + list(call->args) + " });");
+                }
+                else { line("return " + expression(ret->return_node) + ";"); }
+                break;
+            }
+            case NodeKind::Break: line(loops ? "break;" : end_body()); break;
+            case NodeKind::Continue:
+                if (loops || body == Body::ThreadLoop) { line("continue;"); }
+                else { line(end_body()); }
+                break;
+            case NodeKind::Enum: {
+                auto declaration = static_cast<EnumNode*>(node);
+                string values;
+                for (size_t i = 0; i < declaration->values.size(); ++i) { values += (i ? ", " : "") + quoted(symbol_name(declaration->values[i])); }
+                line("enums.set(" + quoted(symbol_name(declaration->name)) + ", { " + values + " });");
+                break;
+            }
+            case NodeKind::Struct:
+                line("// struct " + symbol_name(static_cast<StructNode*>(node)->struct_name));
+                break;
+            case NodeKind::ThreadLoop: thread_loop(static_cast<ThreadLoopNode*>(node)); break;
+            default: line(expression(node) + ";"); break;
+        }
+    }
+
+    // The new arguments are evaluated before any variable is touched, then the frame starts over
+    void tail_call(const FuncCallNode* call) {
+        line("{");
+        ++depth;
+        line("array<Value, " + to_string(call->args.size()) + "> next{ " + list(call->args) + " };");
+        for (uint32_t slot = 0; slot < current_function->frame_size; ++slot) {
+            string name = variable(slot, current_slots.at(slot));
+            if (slot < call->args.size()) { line(name + " = { " + argument("move(next[" + to_string(slot) + "])", current_function, slot) + ", true };"); }
+            else { line(name + " = {};"); }
+        }
+        line("goto entry;");
+        --depth;
+        line("}");
+    }
+
+    void thread_loop(const ThreadLoopNode* loop) {
+        Body outer_body = body;
+        int outer_loops = loops;
+        body = Body::ThreadLoop;
+        loops = 0;
+        line("thread([&]() {");
+        ++depth;
+        line("while (true) {");
+        ++depth;
+        statement(loop->block);
+        --depth;
+        line("}");
+        --depth;
+        line("}).detach();");
+        body = outer_body;
+        loops = outer_loops;
+    }
+
+    void declare_slots(const map<uint32_t, SymbolId>& slots, uint32_t frame_size, const string& prefix) {
+        current_slots = slots;
+        for (uint32_t slot = 0; slot < frame_size; ++slot) {
+            // Only repeated parameter names leave a slot without a name of its own
+            if (!current_slots.count(slot)) { current_slots[slot] = intern("unused"); }
+        }
+        for (const auto& [slot, name] : current_slots) { line(prefix + "hrl::Var " + variable(slot, name) + ";"); }
+    }
+
+    void function(const FuncDeclareNode* function) {
+        Frame frame = scan_frame(function->block_node, function);
+        current_function = function;
+        body = Body::Function;
+        global_frame = false;
+        loops = 0;
+        string name = symbol_name(function->func_name);
+        size_t arity = function->args.size();
+        line("static Value fn_" + name + "(" + parameters(arity) + ") {");
+        ++depth;
+        declare_slots(frame.slots, function->frame_size, "");
+        for (size_t i = 0; i < arity; ++i) { line(variable(i, current_slots.at(i)) + " = { " + argument("move(args[" + to_string(i) + "])", function, i) + ", true };"); }
+        if (frame.uses_enums) { line("hrl::Enums enums;"); }
+        if (frame.self_tail_call) { out << "entry:\n"; }
+        statement(function->block_node);
+        line("return Value();");
+        --depth;
+        line("}");
+        line("");
+        current_function = nullptr;
+    }
+
+    void block_function(const string& name, NodePtr block) {
+        body = Body::TopLevel;
+        global_frame = true;
+        loops = 0;
+        line("static void " + name + "() {");
+        ++depth;
+        statement(block);
+        --depth;
+        line("}");
+        line("");
+    }
+
+public:
+    explicit Transpiler(string source_name) : source_name(move(source_name)) {}
+
+    string run(NodePtr root) {
+        if (root->kind != NodeKind::Program) { throw invalid_argument("hrlc: expected a program with setup and main blocks"); }
+        auto program = static_cast<ProgramNode*>(root);
+        // Functions are global in HRL wherever they are declared, so every declaration becomes a C++ function
+        visit(root, true, [&](NodePtr node) {
+            if (node->kind != NodeKind::FuncDeclare) { return; }
+            auto function = static_cast<FuncDeclareNode*>(node);
+            if (!functions.emplace(function->func_name, function).second) { throw invalid_argument("Function already declared: " + symbol_name(function->func_name)); }
+            function_order.push_back(function);
+        });
+
+        for (const FuncDeclareNode* function : function_order) {
+            visit(function->block_node, false, [&](NodePtr node) {
+                if (node->kind != NodeKind::Return) { return; }
+                if (const FuncDeclareNode* target = other_tail_target(static_cast<ReturnNode*>(node), function)) {
+                    trampolined.insert(function->func_name);
+                    tail_targets.insert(target->func_name);
+                }
+            });
+        }
+
+        for (const FuncDeclareNode* function : function_order) {
+            string name = symbol_name(function->func_name);
+            line("static atomic<bool> " + declared(function->func_name) + ";");
+            line("static Value fn_" + name + "(" + parameters(function->args.size()) + ");");
+        }
+        line("");
+        // Entry points for settle(), which keeps the arguments of a pending tail call in a vector
+        for (const FuncDeclareNode* function : function_order) {
+            if (!tail_targets.count(function->func_name)) { continue; }
+            string name = symbol_name(function->func_name);
+            string args;
+            for (size_t i = 0; i < function->args.size(); ++i) { args += (i ? ", " : "") + string("move(args[") + to_string(i) + "])"; }
+            line("static Value tc_" + name + "(vector<Value>& args) {");
+            line("    hrl::check_declared(" + declared(function->func_name) + ", " + quoted(name) + ");");
+            line("    return fn_" + name + (args.empty() ? "()" : "({ " + args + " })") + ";");
+            line("}");
+            line("");
+        }
+        Frame globals = scan_frame(root, nullptr);
+        declare_slots(globals.slots, program->frame_size, "static ");
+        if (globals.uses_enums) { line("static hrl::Enums enums;"); }
+        line("");
+        for (const FuncDeclareNode* function : function_order) { this->function(function); }
+        current_slots = globals.slots;
+        block_function("hrl_setup", program->setup_block);
+        block_function("hrl_main", program->main_block);
+        line("int main() {");
+        line("    hrl_setup();");
+        line("    while (true) { hrl_main(); }");
+        line("}");
+
+        // Natives and constants are only known once everything has been emitted, so the header goes on last
+        ostringstream header;
+        header << "// Generated by hrlc from " << source_name << ". Build with g++ -O3 -std=c++20 -I<hrl-interpreter>.\n";
+        header << "#include \"Runtime.h\"\n\n";
+        for (const string& name : natives) { header << "static const NativeFunction native_" << name << " = hrl::native(" << quoted(name) << ");\n"; }
+        for (size_t i = 0; i < constants.size(); ++i) { header << "static const Value k" << i << "(string(" << literal(constants[i]) << ", " << constants[i].size() << "));\n"; }
+        header << "\n";
+        return header.str() + out.str();
+    }
+};
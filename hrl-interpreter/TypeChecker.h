@@ -0,0 +1,410 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Static types, run after the resolver. Declared types (`x: int`, `n: int` parameters) and the types of literals,
+// operators and function results are propagated through every frame until nothing changes. Each expression whose
+// values all share one type gets it in Node::type, which lets evaluation skip boxing and the type dispatch of
+// ops::apply. Mismatches that follow from the types alone are reported before the program runs. Stores into a
+// typed variable whose value could not be proven get VarDeclareNode::checked instead, so a typed variable or
+// parameter never holds anything else.
+class TypeChecker {
+private:
+    // What is known about the values of a variable or expression: nothing yet, one type, or several (a seen Null).
+    // Joining only ever moves up, which is what makes the inference terminate.
+    struct Inferred {
+        bool seen = false;
+        ValueType type = ValueType::Null;
+
+        static Inferred of(ValueType type) { return { true, type }; }
+
+        bool join(Inferred other) {
+            if (!other.seen || (seen && type == ValueType::Null)) { return false; }
+            if (!seen) { *this = other; return true; }
+            if (type == other.type) { return false; }
+            type = ValueType::Null;
+            return true;
+        }
+
+        ValueType proven() const { return seen ? type : ValueType::Null; }
+    };
+
+    // The global frame (setup, main and threadloops) or one function's, laid out by the resolver
+    struct Frame {
+        string where;
+        size_t parameters = 0;
+        vector<Inferred> slots;
+        vector<ValueType> declared;
+    };
+
+    struct Function {
+        const FuncDeclareNode* node;
+        size_t frame;
+        Inferred result;
+    };
+
+    struct Flow {
+        bool completes;
+        bool escapes;
+    };
+
+    enum class Phase { Declare, Infer, Check };
+
+    static constexpr size_t NONE = SIZE_MAX;
+
+    vector<Frame> frames;
+    vector<Function> functions;
+    unordered_map<const Node*, size_t> function_index;
+    // Only one declaration of a name can ever run, so a name declared twice is not resolved to either
+    unordered_map<SymbolId, size_t> by_name;
+    Phase phase = Phase::Declare;
+    size_t current = 0;
+    size_t current_function = NONE;
+    bool in_thread_loop = false;
+    bool changed = false;
+
+    [[noreturn]] void fail(const string& message) const { throw invalid_argument(message + " (in " + frames[current].where + ")"); }
+
+    // A value of the type that makes no operator fail for any reason other than its type
+    static Value sample(ValueType type) {
+        switch (type) {
+            case ValueType::Int: return Value(1);
+            case ValueType::Double: return Value(1.0);
+            case ValueType::Bool: return Value(true);
+            case ValueType::String: return Value(string("a"));
+            case ValueType::IntArray: return Value(vector<int>());
+            case ValueType::DoubleArray: return Value(vector<double>());
+            case ValueType::BoolArray: return Value(vector<bool>());
+            case ValueType::StringArray: return Value(vector<string>());
+            default: return Value();
+        }
+    }
+
+    // Operands an arithmetic or comparison promotes to double next to a double
+    static bool is_number(ValueType type) { return type == ValueType::Int || type == ValueType::Double || type == ValueType::Bool; }
+
+    static ValueType array_of(ValueType type) {
+        switch (type) {
+            case ValueType::Int: return ValueType::IntArray;
+            case ValueType::Double: return ValueType::DoubleArray;
+            case ValueType::Bool: return ValueType::BoolArray;
+            case ValueType::String: return ValueType::StringArray;
+            default: return ValueType::Null;
+        }
+    }
+
+    static ValueType element_of(ValueType type) {
+        switch (type) {
+            case ValueType::IntArray: return ValueType::Int;
+            case ValueType::DoubleArray: return ValueType::Double;
+            case ValueType::BoolArray: return ValueType::Bool;
+            case ValueType::StringArray: return ValueType::String;
+            default: return ValueType::Null;
+        }
+    }
+
+    // Whether a function body can end without a return, by running off its end or by a break or continue outside
+    // any loop; the call then returns NULL
+    static Flow flow(NodePtr node, int loop_depth) {
+        if (!node) { return { true, false }; }
+        switch (node->kind) {
+            case NodeKind::Return: return { false, false };
+            case NodeKind::Break: case NodeKind::Continue: return { false, loop_depth == 0 };
+            case NodeKind::Block: {
+                Flow result = { true, false };
+                for (NodePtr statement : static_cast<BlockNode*>(node)->statements) {
+                    Flow next = flow(statement, loop_depth);
+                    result.escapes |= next.escapes;
+                    if (!next.completes) { result.completes = false; break; }
+                }
+                return result;
+            }
+            case NodeKind::If: {
+                Flow then_flow = flow(static_cast<IfNode*>(node)->block, loop_depth);
+                Flow else_flow = flow(static_cast<IfNode*>(node)->else_block, loop_depth);
+                return { then_flow.completes || else_flow.completes, then_flow.escapes || else_flow.escapes };
+            }
+            case NodeKind::While: return { true, flow(static_cast<WhileNode*>(node)->block, loop_depth + 1).escapes };
+            default: return { true, false };
+        }
+    }
+
+    const Function* callee(const FuncCallNode* call) const {
+        if (call->builtin) { return nullptr; }
+        auto it = by_name.find(call->identifier);
+        return it == by_name.end() || it->second == NONE ? nullptr : &functions[it->second];
+    }
+
+    Inferred type_of(NodePtr node) const {
+        const Frame& frame = frames[current];
+        switch (node->kind) {
+            case NodeKind::IntVal: case NodeKind::EnumVal: return Inferred::of(ValueType::Int);
+            case NodeKind::DoubleVal: return Inferred::of(ValueType::Double);
+            case NodeKind::StringVal: return Inferred::of(ValueType::String);
+            case NodeKind::Var: return frame.slots[static_cast<VarNode*>(node)->slot];
+            case NodeKind::BinOp: {
+                auto binop = static_cast<BinOpNode*>(node);
+                if (!ops::is_arithmetic(binop->op)) { return Inferred::of(ops::result_type(binop->op, ValueType::Null, ValueType::Null)); }
+                // One double operand is enough to make the result a double
+                Inferred left = type_of(binop->left), right = type_of(binop->right);
+                if (left.proven() == ValueType::Double || right.proven() == ValueType::Double) { return Inferred::of(ValueType::Double); }
+                if (!left.seen || !right.seen) { return {}; }
+                return Inferred::of(ops::result_type(binop->op, left.type, right.type));
+            }
+            case NodeKind::UnOp: {
+                auto unop = static_cast<UnOpNode*>(node);
+                if (unop->op != UnOp::Not) {
+                    Inferred child = type_of(unop->child);
+                    if (!child.seen) { return child; }
+                    return Inferred::of(child.type == ValueType::Int || child.type == ValueType::Double ? child.type : ValueType::Null);
+                }
+                return Inferred::of(ValueType::Bool);
+            }
+            case NodeKind::Array: {
+                auto array = static_cast<ArrayNode*>(node);
+                if (array->nodes.size() == 0) { return Inferred::of(ValueType::IntArray); }
+                Inferred elements;
+                for (NodePtr element : array->nodes) { elements.join(type_of(element)); }
+                if (!elements.seen) { return elements; }
+                return Inferred::of(array_of(elements.type));
+            }
+            case NodeKind::ArrayAccess: {
+                Inferred array = frame.slots[static_cast<ArrayAccessNode*>(node)->slot];
+                if (!array.seen) { return array; }
+                return Inferred::of(element_of(array.type));
+            }
+            case NodeKind::FuncCall: {
+                const Function* function = callee(static_cast<FuncCallNode*>(node));
+                return function ? function->result : Inferred::of(ValueType::Null);
+            }
+            default: return Inferred::of(ValueType::Null);
+        }
+    }
+
+    void enter_function(const FuncDeclareNode* declaration) {
+        if (phase == Phase::Declare) {
+            Frame frame;
+            frame.where = "function " + symbol_name(declaration->func_name);
+            frame.parameters = declaration->args.size();
+            frame.slots.resize(declaration->frame_size);
+            frame.declared.resize(declaration->frame_size, ValueType::Null);
+            for (size_t i = 0; i < frame.parameters; ++i) {
+                ValueType type = i < declaration->arg_types.size() ? declaration->arg_types[i] : ValueType::Null;
+                frame.slots[i] = Inferred::of(type);
+                frame.declared[i] = type;
+            }
+            frames.push_back(move(frame));
+            function_index[declaration] = functions.size();
+            auto name = by_name.emplace(declaration->func_name, functions.size());
+            if (!name.second) { name.first->second = NONE; }
+            functions.push_back({ declaration, frames.size() - 1, {} });
+        }
+        size_t outer = current, outer_function = current_function;
+        bool outer_thread_loop = in_thread_loop;
+        current_function = function_index[declaration];
+        current = functions[current_function].frame;
+        in_thread_loop = false;
+        statement(declaration->block_node);
+        current = outer;
+        current_function = outer_function;
+        in_thread_loop = outer_thread_loop;
+    }
+
+    // A declaration without an initializer stores the zero of its own declared type
+    void store(uint32_t slot, SymbolId name, NodePtr expression, ValueType declared_here, ValueType& checked) {
+        Frame& frame = frames[current];
+        ValueType& declared = frame.declared[slot];
+        switch (phase) {
+            case Phase::Declare:
+                if (declared_here == ValueType::Null) { return; }
+                if (declared != ValueType::Null && declared != declared_here) {
+                    fail("Type mismatch: " + symbol_name(name) + " is declared both " + valueTypeName(declared) + " and " + valueTypeName(declared_here));
+                }
+                declared = declared_here;
+                if (slot >= frame.parameters) { frame.slots[slot] = Inferred::of(declared); }
+                return;
+            case Phase::Infer:
+                if (declared != ValueType::Null) { return; }
+                changed |= frame.slots[slot].join(expression ? type_of(expression) : Inferred::of(ValueType::Int));
+                return;
+            case Phase::Check: {
+                if (expression) { this->expression(expression); }
+                if (declared == ValueType::Null) { return; }
+                ValueType stored = expression ? expression->type : ops::zero(declared_here).type();
+                if (stored == ValueType::Null || (stored == ValueType::Int && declared == ValueType::Double)) { checked = declared; }
+                else if (stored != declared) { fail(ops::type_mismatch(symbol_name(name), declared, stored).what()); }
+                return;
+            }
+        }
+    }
+
+    void returned(const ReturnNode* ret) {
+        if (current_function == NONE || in_thread_loop) {
+            if (phase == Phase::Check) { expression(ret->return_node); }
+            return;
+        }
+        Function& function = functions[current_function];
+        if (phase == Phase::Infer) { changed |= function.result.join(type_of(ret->return_node)); }
+        if (phase != Phase::Check) { return; }
+        expression(ret->return_node);
+        ValueType declared = function.node->return_type, returned = ret->return_node->type;
+        if (declared != ValueType::Null && returned != ValueType::Null && returned != declared) {
+            fail("Type mismatch: " + symbol_name(function.node->func_name) + " is declared to return " + valueTypeName(declared) + ", got " + valueTypeName(returned));
+        }
+    }
+
+    void condition(NodePtr node) {
+        if (phase != Phase::Check) { return; }
+        expression(node);
+        if (node->type != ValueType::Null && node->type != ValueType::Bool) {
+            fail(string("Type mismatch: expected bool, got ") + valueTypeName(node->type));
+        }
+    }
+
+    void statement(NodePtr node) {
+        if (!node) { return; }
+        switch (node->kind) {
+            case NodeKind::Program:
+                statement(static_cast<ProgramNode*>(node)->setup_block);
+                statement(static_cast<ProgramNode*>(node)->main_block);
+                break;
+            case NodeKind::Block:
+                for (NodePtr child : static_cast<BlockNode*>(node)->statements) { statement(child); }
+                break;
+            case NodeKind::If:
+                condition(static_cast<IfNode*>(node)->condition);
+                statement(static_cast<IfNode*>(node)->block);
+                statement(static_cast<IfNode*>(node)->else_block);
+                break;
+            case NodeKind::While:
+                condition(static_cast<WhileNode*>(node)->condition);
+                statement(static_cast<WhileNode*>(node)->block);
+                break;
+            case NodeKind::ThreadLoop: {
+                // A return in a threadloop only ends the loop, so it is not a result of the enclosing function
+                bool outer = in_thread_loop;
+                in_thread_loop = true;
+                statement(static_cast<ThreadLoopNode*>(node)->block);
+                in_thread_loop = outer;
+                break;
+            }
+            case NodeKind::FuncDeclare: enter_function(static_cast<FuncDeclareNode*>(node)); break;
+            case NodeKind::VarDeclare: {
+                auto declare = static_cast<VarDeclareNode*>(node);
+                store(declare->slot, declare->identifier, declare->expression, declare->declared, declare->checked);
+                break;
+            }
+            case NodeKind::Assignment: {
+                auto assignment = static_cast<AssignmentNode*>(node);
+                store(assignment->slot, assignment->identifier, assignment->expression, ValueType::Null, assignment->checked);
+                break;
+            }
+            case NodeKind::Return: returned(static_cast<ReturnNode*>(node)); break;
+            default:
+                if (phase == Phase::Check) { expression(node); }
+                break;
+        }
+    }
+
+    // Annotates the expression and its operands, failing on operations that could only ever throw
+    void expression(NodePtr node) {
+        switch (node->kind) {
+            case NodeKind::BinOp: {
+                auto binop = static_cast<BinOpNode*>(node);
+                expression(binop->left);
+                expression(binop->right);
+                ValueType left = binop->left->type, right = binop->right->type;
+                if (left != ValueType::Null && right != ValueType::Null) {
+                    try { ops::apply(binop->op, sample(left), sample(right)); }
+                    catch (const invalid_argument& error) { fail(error.what()); }
+                }
+                if (left == right && (left == ValueType::Int || left == ValueType::Bool)) { binop->operands = left; }
+                else if (is_number(left) && is_number(right) && (left == ValueType::Double || right == ValueType::Double)) { binop->operands = ValueType::Double; }
+                break;
+            }
+            case NodeKind::UnOp: {
+                auto unop = static_cast<UnOpNode*>(node);
+                expression(unop->child);
+                if (unop->child->type != ValueType::Null) {
+                    try { ops::unary(unop->op, sample(unop->child->type)); }
+                    catch (const invalid_argument& error) { fail(error.what()); }
+                }
+                break;
+            }
+            case NodeKind::FuncCall: {
+                auto call = static_cast<FuncCallNode*>(node);
+                for (NodePtr arg : call->args) { expression(arg); }
+                const Function* function = callee(call);
+                if (!function) { break; }
+                const FuncDeclareNode* declaration = function->node;
+                for (size_t i = 0; i < call->args.size() && i < declaration->arg_types.size(); ++i) {
+                    ValueType declared = declaration->arg_types[i], passed = call->args[i]->type;
+                    bool promoted = passed == ValueType::Int && declared == ValueType::Double;
+                    if (declared != ValueType::Null && passed != ValueType::Null && passed != declared && !promoted) {
+                        fail(ops::type_mismatch(symbol_name(declaration->args[i]), declared, passed).what());
+                    }
+                }
+                break;
+            }
+            case NodeKind::Array: {
+                auto array = static_cast<ArrayNode*>(node);
+                ValueType first = ValueType::Null;
+                for (NodePtr element : array->nodes) {
+                    expression(element);
+                    if (element->type == ValueType::Null) { continue; }
+                    if (first != ValueType::Null && element->type != first) { fail("Array elements must all have the same type"); }
+                    first = element->type;
+                }
+                break;
+            }
+            case NodeKind::ArrayAccess: {
+                auto access = static_cast<ArrayAccessNode*>(node);
+                expression(access->index);
+                ValueType array = frames[current].slots[access->slot].proven();
+                if (array != ValueType::Null && element_of(array) == ValueType::Null) { fail("Unsupported array type."); }
+                if (access->index->type != ValueType::Null && access->index->type != ValueType::Int) {
+                    fail(string("Type mismatch: expected int, got ") + valueTypeName(access->index->type));
+                }
+                break;
+            }
+            default: break;
+        }
+        node->type = type_of(node).proven();
+    }
+
+public:
+    void run(NodePtr root) {
+        frames.assign(1, Frame());
+        frames[0].where = "setup or main";
+        if (root->kind == NodeKind::Program) {
+            uint32_t size = static_cast<ProgramNode*>(root)->frame_size;
+            frames[0].slots.resize(size);
+            frames[0].declared.resize(size, ValueType::Null);
+        }
+        functions.clear();
+        function_index.clear();
+        by_name.clear();
+        current = 0;
+        current_function = NONE;
+        in_thread_loop = false;
+
+        phase = Phase::Declare;
+        statement(root);
+        for (Function& function : functions) {
+            Flow body = flow(function.node->block_node, 0);
+            if (body.completes || body.escapes) { function.result = Inferred::of(ValueType::Null); }
+        }
+        phase = Phase::Infer;
+        do {
+            changed = false;
+            statement(root);
+        } while (changed);
+        phase = Phase::Check;
+        statement(root);
+    }
+};
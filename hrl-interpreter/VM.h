@@ -0,0 +1,176 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Bytecode.h"
+using namespace std;
+
+// Executes bytecode compiled from the AST. Function bodies are compiled lazily on their first call and cached by
+// block node; the function's FuncInfo then points at its chunk, so every later call runs straight from it.
+class VM {
+private:
+    FuncTable& func_table;
+    unordered_map<const Node*, unique_ptr<Chunk>> chunks;
+    mutex chunks_lock;
+
+    template <typename Compile>
+    const Chunk& cached(NodePtr node, Compile compile) {
+        lock_guard<mutex> guard(chunks_lock);
+        auto& chunk = chunks[node];
+        if (!chunk) { chunk = make_unique<Chunk>(compile(node)); }
+        return *chunk;
+    }
+
+    EvalResult call(const Chunk& chunk, const Instr& instr, const EvalResult* registers) {
+        // The call site's FuncCallNode holds the inline cache, shared with the tree-walker
+        auto call_node = static_cast<const FuncCallNode*>(chunk.nodes[instr.b]);
+        const FuncInfo* func_info = &call_node->resolve(func_table);
+        call_node->check_arity(*func_info, instr.d);
+        PooledFrame<Slot> frame(func_info->frame_size);
+        for (int i = 0; i < instr.d; i++) { frame.items[i] = { registers[instr.c + i], true }; }
+        FuncCallNode::check_arguments(*func_info, frame.items);
+        SymbolTable new_symbol_table(frame.items);
+        while (true) {
+            EvalResult result;
+            if (!FuncCallNode::run_native(*func_info, new_symbol_table, result)) { result = execute(function_chunk(*func_info), new_symbol_table); }
+            if (new_symbol_table.completion != Completion::TailCall) { return result; }
+            func_info = &FuncCallNode::enter_tail_call(new_symbol_table, frame, func_table);
+        }
+    }
+
+public:
+    VM(FuncTable& func_table) : func_table(func_table) {}
+
+    const Chunk& chunk_for(NodePtr block) { return cached(block, BytecodeCompiler::compile); }
+
+    const Chunk& loop_chunk_for(NodePtr loop) { return cached(loop, BytecodeCompiler::compile_loop); }
+
+    // Publishes the chunk in the FuncInfo the first time, which every engine reads without taking the lock
+    const Chunk& function_chunk(const FuncInfo& func_info) {
+        const Chunk* chunk = func_info.chunk.load(memory_order_acquire);
+        if (!chunk) {
+            chunk = &chunk_for(func_info.block);
+            func_info.chunk.store(chunk, memory_order_release);
+        }
+        return *chunk;
+    }
+
+    EvalResult execute(const Chunk& chunk, SymbolTable& symbol_table) {
+        PooledFrame<EvalResult> registers(chunk.register_count);
+        EvalResult* R = registers.items;
+        const Instr* code = chunk.code.data();
+        const Instr* ip = code;
+        const Instr* instr;
+
+#ifdef __GNUC__
+        // Threaded dispatch: every handler jumps straight to the next one instead of going back through a switch
+        static void* const labels[] = {
+#define HRL_OPCODE_LABEL(name) &&op_##name,
+            HRL_OPCODES(HRL_OPCODE_LABEL)
+#undef HRL_OPCODE_LABEL
+        };
+#define CASE(name) op_##name:
+#define DISPATCH() do { instr = ip++; goto *labels[static_cast<int>(instr->op)]; } while (0)
+        DISPATCH();
+#else
+#define CASE(name) case OpCode::name:
+#define DISPATCH() break
+        while (true) {
+            instr = ip++;
+            switch (instr->op) {
+#endif
+        CASE(LOADK) {
+            R[instr->a] = chunk.constants[instr->b];
+            DISPATCH();
+        }
+        CASE(LOADVAR) {
+            R[instr->a] = symbol_table.getVariable(instr->b, instr->c);
+            DISPATCH();
+        }
+        CASE(STOREVAR) {
+            if (R[instr->b].is_null()) { throw invalid_argument("Cannot assign NULL value to variable " + symbol_name(instr->c)); }
+            symbol_table.setVariable(instr->a, R[instr->b]);
+            DISPATCH();
+        }
+        CASE(CHECK) {
+            // A NULL is left for STOREVAR to report
+            ValueType declared = static_cast<ValueType>(instr->b);
+            if (!R[instr->a].is_null() && !ops::conform(R[instr->a], declared)) { throw ops::type_mismatch(symbol_name(instr->c), declared, R[instr->a].type()); }
+            DISPATCH();
+        }
+        CASE(BINOP) {
+            R[instr->a] = ops::apply(static_cast<BinOp>(instr->d), R[instr->b], R[instr->c]);
+            DISPATCH();
+        }
+        CASE(BINOPI) {
+            BinOp op = static_cast<BinOp>(instr->d);
+            int left = R[instr->b].int_unchecked(), right = R[instr->c].int_unchecked();
+            if (ops::is_arithmetic(op)) { R[instr->a] = EvalResult(ops::arithmetic(op, left, right)); }
+            else { R[instr->a] = EvalResult(ops::compare(op, left, right)); }
+            DISPATCH();
+        }
+        CASE(BINOPD) {
+            BinOp op = static_cast<BinOp>(instr->d);
+            double left = ops::to_double(R[instr->b]), right = ops::to_double(R[instr->c]);
+            if (ops::is_arithmetic(op)) { R[instr->a] = EvalResult(ops::arithmetic(op, left, right)); }
+            else { R[instr->a] = EvalResult(ops::compare(op, left, right)); }
+            DISPATCH();
+        }
+        CASE(JMP) {
+            ip = code + instr->a;
+            DISPATCH();
+        }
+        CASE(JMPF) {
+            if (!R[instr->a].as_bool()) { ip = code + instr->b; }
+            DISPATCH();
+        }
+        CASE(CALL) {
+            R[instr->a] = call(chunk, *instr, R);
+            DISPATCH();
+        }
+        CASE(TAILCALL) {
+            // Unwind to call(), which runs the callee on this frame
+            for (int i = 0; i < instr->d; i++) { symbol_table.tail_args.push_back(move(R[instr->c + i])); }
+            symbol_table.tail_call = static_cast<const FuncCallNode*>(chunk.nodes[instr->b]);
+            symbol_table.completion = Completion::TailCall;
+            return EvalResult();
+        }
+        CASE(NATIVE) {
+            R[instr->a] = Builtins::global().at(instr->b).function(R + instr->c, instr->d);
+            DISPATCH();
+        }
+        CASE(EVAL) {
+            R[instr->a] = chunk.nodes[instr->b]->Evaluate(symbol_table, func_table);
+            DISPATCH();
+        }
+        CASE(RET) {
+            return R[instr->a];
+        }
+        CASE(LOOPRET) {
+            symbol_table.return_value = move(R[instr->a]);
+            symbol_table.completion = Completion::Return;
+            return EvalResult();
+        }
+        CASE(RETNULL) {
+            return EvalResult();
+        }
+#ifndef __GNUC__
+            }
+        }
+#endif
+#undef CASE
+#undef DISPATCH
+    }
+
+    // Runs a parsed script: the setup block once, then the main block forever, as ProgramNode does
+    EvalResult run(NodePtr root, SymbolTable& symbol_table) {
+        if (root->kind != NodeKind::Program) { return execute(chunk_for(root), symbol_table); }
+        auto program = static_cast<ProgramNode*>(root);
+        symbol_table.resize(program->frame_size);
+        execute(chunk_for(program->setup_block), symbol_table);
+        const Chunk& main_chunk = chunk_for(program->main_block);
+        while (true) { execute(main_chunk, symbol_table); }
+        return EvalResult(0);
+    }
+};
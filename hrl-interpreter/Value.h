@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+enum class ValueType : uint8_t { Null, Int, Double, Bool, String, IntArray, DoubleArray, BoolArray, StringArray };
+
+inline const char* valueTypeName(ValueType type) {
+    static const char* names[] = { "null", "int", "double", "bool", "string", "int[]", "double[]", "bool[]", "string[]" };
+    return names[static_cast<int>(type)];
+}
+
+// Type named in a declaration such as `x: int`; enums, structs and other names the interpreter cannot check give Null
+inline ValueType valueTypeNamed(string_view name) {
+    if (name == "int") { return ValueType::Int; }
+    if (name == "double") { return ValueType::Double; }
+    if (name == "bool") { return ValueType::Bool; }
+    if (name == "string") { return ValueType::String; }
+    return ValueType::Null;
+}
+
+// Immutable, reference-counted payload of a string or array value. Counts are atomic because values are shared
+// between the main thread, threadloops and parallel sections.
+struct HeapObject {
+    mutable atomic<uint32_t> references{ 1 };
+    virtual ~HeapObject() = default;
+};
+
+struct StringObject : HeapObject {
+    string text;
+    explicit StringObject(string text) : text(move(text)) {}
+};
+
+template <typename T>
+struct ArrayObject : HeapObject {
+    vector<T> items;
+    explicit ArrayObject(vector<T> items) : items(move(items)) {}
+};
+
+class Value;
+
+template <typename T> struct ArrayTypeOf;
+template <> struct ArrayTypeOf<int> { static constexpr ValueType type = ValueType::IntArray; };
+template <> struct ArrayTypeOf<double> { static constexpr ValueType type = ValueType::DoubleArray; };
+template <> struct ArrayTypeOf<bool> { static constexpr ValueType type = ValueType::BoolArray; };
+template <> struct ArrayTypeOf<string> { static constexpr ValueType type = ValueType::StringArray; };
+
+// 16-byte tagged value: ints, doubles and bools are stored inline, strings and arrays point at a shared immutable
+// HeapObject, so copying any value is O(1). A default-constructed Value is null.
+class Value {
+private:
+    ValueType tag = ValueType::Null;
+    union {
+        int int_value;
+        double double_value;
+        bool bool_value;
+        const HeapObject* object;
+    };
+
+    bool on_heap() const { return tag >= ValueType::String; }
+    void retain() const { if (on_heap()) { object->references.fetch_add(1, memory_order_relaxed); } }
+    void release() const {
+        if (on_heap() && object->references.fetch_sub(1, memory_order_acq_rel) == 1) { delete object; }
+    }
+
+    [[noreturn]] void mismatch(ValueType expected) const {
+        throw invalid_argument(string("Type mismatch: expected ") + valueTypeName(expected) + ", got " + valueTypeName(tag));
+    }
+
+public:
+    Value() : int_value(0) {}
+    Value(int value) : tag(ValueType::Int), int_value(value) {}
+    Value(double value) : tag(ValueType::Double), double_value(value) {}
+    Value(bool value) : tag(ValueType::Bool), bool_value(value) {}
+    Value(string value) : tag(ValueType::String), object(new StringObject(move(value))) {}
+    Value(const char* value) : Value(string(value)) {}
+    template <typename T>
+    Value(vector<T> items) : tag(ArrayTypeOf<T>::type), object(new ArrayObject<T>(move(items))) {}
+
+    Value(const Value& other) : tag(other.tag), double_value(0) {
+        if (on_heap()) { object = other.object; retain(); }
+        else { double_value = other.double_value; }
+    }
+    Value(Value&& other) noexcept : tag(other.tag), double_value(0) {
+        if (on_heap()) { object = other.object; }
+        else { double_value = other.double_value; }
+        other.tag = ValueType::Null;
+    }
+    Value& operator=(const Value& other) {
+        other.retain();
+        release();
+        tag = other.tag;
+        if (on_heap()) { object = other.object; }
+        else { double_value = other.double_value; }
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            tag = other.tag;
+            if (on_heap()) { object = other.object; }
+            else { double_value = other.double_value; }
+            other.tag = ValueType::Null;
+        }
+        return *this;
+    }
+    ~Value() { release(); }
+
+    ValueType type() const { return tag; }
+    bool is_null() const { return tag == ValueType::Null; }
+    bool is_int() const { return tag == ValueType::Int; }
+    bool is_double() const { return tag == ValueType::Double; }
+    bool is_bool() const { return tag == ValueType::Bool; }
+    bool is_string() const { return tag == ValueType::String; }
+    bool is_array() const { return tag >= ValueType::IntArray; }
+
+    int as_int() const { if (tag != ValueType::Int) { mismatch(ValueType::Int); } return int_value; }
+    double as_double() const { if (tag != ValueType::Double) { mismatch(ValueType::Double); } return double_value; }
+    bool as_bool() const { if (tag != ValueType::Bool) { mismatch(ValueType::Bool); } return bool_value; }
+    const string& as_string() const {
+        if (tag != ValueType::String) { mismatch(ValueType::String); }
+        return static_cast<const StringObject*>(object)->text;
+    }
+    template <typename T>
+    const vector<T>& as_array() const {
+        if (tag != ArrayTypeOf<T>::type) { mismatch(ArrayTypeOf<T>::type); }
+        return static_cast<const ArrayObject<T>*>(object)->items;
+    }
+
+    // Unchecked accessors for callers that already switched on type()
+    int int_unchecked() const { return int_value; }
+    double double_unchecked() const { return double_value; }
+    bool bool_unchecked() const { return bool_value; }
+
+    size_t array_size() const {
+        switch (tag) {
+            case ValueType::IntArray: return as_array<int>().size();
+            case ValueType::DoubleArray: return as_array<double>().size();
+            case ValueType::BoolArray: return as_array<bool>().size();
+            case ValueType::StringArray: return as_array<string>().size();
+            default: throw invalid_argument(string("Cannot index a value of type ") + valueTypeName(tag));
+        }
+    }
+
+    Value element(int index) const {
+        if (index < 0 || static_cast<size_t>(index) >= array_size()) { throw out_of_range("Array index " + to_string(index) + " out of range"); }
+        switch (tag) {
+            case ValueType::IntArray: return Value(as_array<int>()[index]);
+            case ValueType::DoubleArray: return Value(as_array<double>()[index]);
+            case ValueType::BoolArray: return Value(static_cast<bool>(as_array<bool>()[index]));
+            default: return Value(as_array<string>()[index]);
+        }
+    }
+
+    bool operator==(const Value& other) const {
+        if (tag != other.tag) { return false; }
+        switch (tag) {
+            case ValueType::Null: return true;
+            case ValueType::Int: return int_value == other.int_value;
+            case ValueType::Double: return double_value == other.double_value;
+            case ValueType::Bool: return bool_value == other.bool_value;
+            case ValueType::String: return as_string() == other.as_string();
+            case ValueType::IntArray: return as_array<int>() == other.as_array<int>();
+            case ValueType::DoubleArray: return as_array<double>() == other.as_array<double>();
+            case ValueType::BoolArray: return as_array<bool>() == other.as_array<bool>();
+            case ValueType::StringArray: return as_array<string>() == other.as_array<string>();
+        }
+        return false;
+    }
+    bool operator!=(const Value& other) const { return !(*this == other); }
+};
+
+static_assert(sizeof(Value) <= 16, "Value must stay within 16 bytes");
@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+using namespace std;
+
+// Helpers shared by the benchmark drivers in this directory. Each driver is a single translation unit built against
+// the interpreter's headers by `make bench`, needs no arguments and prints one table per measurement.
+namespace bench {
+
+// Fastest of `runs` timings of f, in seconds
+template <typename F>
+double best_of(int runs, F f) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        auto start = chrono::steady_clock::now();
+        f();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// A valid script of about `bytes` bytes: setup declares functions with loops, branches, string literals and
+// comments, then calls stop(), which is undefined, so ./main exits once setup has run
+inline string generate_script(size_t bytes) {
+    string code = "-- Generated benchmark script\r\nsetup {\r\n";
+    for (size_t i = 0; code.size() < bytes; ++i) {
+        string n = to_string(i);
+        code += "    -- Unit " + n + ": accumulate, classify and report\r\n"
+                "    function unit" + n + "(count, scale) {{\r\n"
+                "        total = 0;\r\n"
+                "        while (count > 0) {{\r\n"
+                "            total = total + count * scale - " + to_string(i % 97) + ";\r\n"
+                "            if (total % 7 == 0) {{ print(\"unit " + n + " hit a multiple of seven\"); }} else {{ total = total + 1; }}\r\n"
+                "            count = count - 1;\r\n"
+                "        }}\r\n"
+                "        return total;\r\n"
+                "    }}\r\n"
+                "    const limit" + n + " = " + to_string(i * 3 + 1) + ";\r\n"
+                "    status" + n + " = \"sensor " + n + " reports nominal readings\" .. limit" + n + ";\r\n";
+    }
+    return code + "    stop();\r\n}\r\nmain {\r\n}\r\n";
+}
+
+}
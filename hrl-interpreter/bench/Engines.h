@@ -0,0 +1,57 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "Parser.h"
+#include "Tiering.h"
+#include "VM.h"
+using namespace std;
+
+// Runs a script's setup block on one of main's engines, for the drivers that compare them
+namespace bench {
+
+enum class Engine { Tree, Vm, Tiered };
+
+inline const char* engine_name(Engine engine) {
+    switch (engine) {
+        case Engine::Tree: return "tree";
+        case Engine::Vm: return "vm";
+        default: return "tiered";
+    }
+}
+
+// Seconds spent in setup on the given engine. Every run parses its own tree, since the tiered engine leaves compiled
+// chunks on the nodes; parsing is not timed. Scripts should not call stop(): the timing ends with setup. prepare, if
+// given, may rewrite the parsed tree first.
+inline double time_setup(Engine engine, string_view code, const function<void(NodePtr)>& prepare = nullptr, uint32_t tier_threshold = 1000) {
+    Arena arena;
+    auto program = static_cast<ProgramNode*>(Parser(arena).run(code));
+    if (prepare) { prepare(program); }
+    SymbolTable table;
+    FuncTable func_table;
+    table.resize(program->frame_size);
+    unique_ptr<BytecodeTier> tier;
+    if (engine == Engine::Tiered) {
+        tier = make_unique<BytecodeTier>(func_table, code, tier_threshold);
+        func_table.tiering = tier.get();
+    }
+    auto start = chrono::steady_clock::now();
+    if (engine == Engine::Vm) {
+        VM vm(func_table);
+        vm.execute(vm.chunk_for(program->setup_block), table);
+    }
+    else { program->setup_block->Evaluate(table, func_table); }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Fastest of `runs` setup timings
+inline double best_setup(int runs, Engine engine, string_view code, const function<void(NodePtr)>& prepare = nullptr) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) { best = min(best, time_setup(engine, code, prepare)); }
+    return best;
+}
+
+}
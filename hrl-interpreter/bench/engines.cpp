@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <string>
+#include "Bench.h"
+#include "Engines.h"
+using namespace std;
+
+// The tree-walker, the bytecode VM and the tiered engine on loops, recursion and string building
+
+const int RUNS = 3;
+
+struct Workload {
+    const char* name;
+    const char* code;
+};
+
+const Workload WORKLOADS[] = {
+    { "arithmetic loop, 3M iterations",
+      "setup {\n"
+      "    i = 0;\n"
+      "    s = 0;\n"
+      "    while (i < 3000000) {{\n"
+      "        s = s + i * 2 % 7;\n"
+      "        i = i + 1;\n"
+      "    }}\n"
+      "}\n"
+      "main {\n"
+      "}\n" },
+    { "recursive fib(25)",
+      "setup {\n"
+      "    function fib(n) {{\n"
+      "        if (n < 2) {{ return n; }}\n"
+      "        return fib(n - 1) + fib(n - 2);\n"
+      "    }}\n"
+      "    result = fib(25);\n"
+      "}\n"
+      "main {\n"
+      "}\n" },
+    { "string building, 20k appends",
+      "setup {\n"
+      "    text = \"\";\n"
+      "    i = 0;\n"
+      "    while (i < 20000) {{\n"
+      "        text = text .. (i % 10) .. \",\";\n"
+      "        i = i + 1;\n"
+      "    }}\n"
+      "}\n"
+      "main {\n"
+      "}\n" },
+};
+
+int main() {
+    const bench::Engine engines[] = { bench::Engine::Tree, bench::Engine::Vm, bench::Engine::Tiered };
+    printf("Engines, ms (best of %d)\n", RUNS);
+    printf("  %-32s", "workload");
+    for (bench::Engine engine : engines) { printf(" %10s", bench::engine_name(engine)); }
+    printf(" %12s\n", "vm speedup");
+    for (const Workload& workload : WORKLOADS) {
+        printf("  %-32s", workload.name);
+        double tree = 0, vm = 0;
+        for (bench::Engine engine : engines) {
+            double seconds = bench::best_setup(RUNS, engine, workload.code);
+            if (engine == bench::Engine::Tree) { tree = seconds; }
+            if (engine == bench::Engine::Vm) { vm = seconds; }
+            printf(" %10.1f", seconds * 1e3);
+            fflush(stdout);
+        }
+        printf(" %11.2fx\n", tree / vm);
+    }
+    return 0;
+}
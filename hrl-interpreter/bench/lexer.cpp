@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Bench.h"
+#include "Tokenizer.h"
+using namespace std;
+
+// Lexer throughput in tokens per second, plus the cost of telling keywords from identifiers with the constexpr
+// lookupKeyword compared to the per-Tokenizer unordered_map<string, string> it replaced.
+// usage: lexer [file.hr...]; without files it lexes generated 1 MB and 10 MB scripts
+
+const int RUNS = 5;
+
+// The table every Tokenizer used to build, mapping keyword and operator spellings to token kind names
+unordered_map<string, string> legacy_keyword_map() {
+    const char* entries[][2] = {
+        {"setup", "SETUP"}, {"main", "MAIN"}, {"enum", "ENUM"}, {"struct", "STRUCT"}, {"behavior", "BEHAVIOR"},
+        {"while", "WHILE"}, {"if", "IF"}, {"else", "ELSE"}, {"switch", "SWITCH"}, {"case", "CASE"}, {"const", "CONST"},
+        {"function", "FUNCTION"}, {"threadloop", "THREADLOOP"}, {"break", "BREAK"}, {"continue", "CONTINUE"},
+        {"return", "RETURN"}, {"==", "EQ"}, {"!=", "NEQ"}, {"<", "LT"}, {"<=", "LE"}, {">", "GT"}, {">=", "GE"},
+        {":", "COLON"}, {",", "COMMA"}, {"=", "ASSIGN"}, {";", "SEMICOLON"}, {"{", "LBRACE"}, {"}", "RBRACE"},
+        {"(", "LPAREN"}, {")", "RPAREN"}, {".", "DOT"}, {"[", "LBRACKET"}, {"]", "RBRACKET"}, {"+", "PLUS"},
+        {"-", "MINUS"}, {"*", "MULT"}, {"/", "DIV"}, {"%", "MOD"}, {"&&", "AND"}, {"||", "OR"}, {"!", "NOT"},
+        {"..", "CONCAT"}
+    };
+    unordered_map<string, string> map;
+    for (auto& entry : entries) { map[entry[0]] = entry[1]; }
+    return map;
+}
+
+struct Result {
+    string name;
+    size_t bytes, tokens, words;
+    double seconds, lookup_seconds, map_seconds;
+};
+
+Result measure(const string& name, const string& code) {
+    Result result{ name, code.size() };
+    TokenBuffer tokens;
+    result.seconds = bench::best_of(RUNS, [&] {
+        tokens = TokenBuffer();
+        Tokenizer(code).tokenize(tokens);
+    });
+    result.tokens = tokens.size();
+
+    // Every word the lexer classified: identifiers and keywords
+    vector<string_view> words;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (tokens.kinds[i] == TokenType::IDENTIFIER || tokens.kinds[i] <= TokenType::RETURN) { words.push_back(tokens.text(i)); }
+    }
+    result.words = words.size();
+    size_t keywords = 0, legacy_keywords = 0;
+    result.lookup_seconds = bench::best_of(RUNS, [&] {
+        keywords = 0;
+        for (string_view word : words) { keywords += lookupKeyword(word) != TokenType::IDENTIFIER; }
+    });
+    unordered_map<string, string> keyword_map = legacy_keyword_map();
+    result.map_seconds = bench::best_of(RUNS, [&] {
+        legacy_keywords = 0;
+        for (string_view word : words) {
+            string identifier(word);
+            string type = keyword_map.count(identifier) ? keyword_map[identifier] : "IDENTIFIER";
+            legacy_keywords += type != "IDENTIFIER";
+        }
+    });
+    if (keywords != legacy_keywords) { throw runtime_error("Keyword counts differ for " + name); }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    vector<Result> results;
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            ifstream file(argv[i], ios::binary);
+            if (!file) {
+                cerr << "Error: Unable to open file " << argv[i] << endl;
+                return 1;
+            }
+            stringstream contents;
+            contents << file.rdbuf();
+            results.push_back(measure(argv[i], contents.str()));
+        }
+    } else {
+        results.push_back(measure("generated 1 MB", bench::generate_script(1000000)));
+        results.push_back(measure("generated 10 MB", bench::generate_script(10000000)));
+    }
+
+    printf("Lexer throughput (best of %d, scan kernels: %s)\n", RUNS, scan::kernels().name);
+    printf("  %-24s %10s %10s %10s %10s\n", "input", "MB", "tokens", "ms", "Mtok/s");
+    for (const Result& r : results) {
+        printf("  %-24s %10.1f %10zu %10.1f %10.1f\n", r.name.c_str(), r.bytes / 1e6, r.tokens, r.seconds * 1e3, r.tokens / r.seconds / 1e6);
+    }
+    printf("Keyword recognition, ns per identifier or keyword\n");
+    printf("  %-24s %10s %14s %14s\n", "input", "words", "lookupKeyword", "keyword map");
+    for (const Result& r : results) {
+        printf("  %-24s %10zu %14.1f %14.1f\n", r.name.c_str(), r.words, r.lookup_seconds / r.words * 1e9, r.map_seconds / r.words * 1e9);
+    }
+    return 0;
+}
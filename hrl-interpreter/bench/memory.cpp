@@ -0,0 +1,104 @@
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "Parser.h"
+using namespace std;
+
+// Memory taken by parsed scripts. In process: AST nodes, arena bytes per node and heap growth while parsing
+// (tokens included). Per process: peak RSS of interpreter binaries running generated scripts, which end right after
+// setup, so builds from before and after a change can be compared.
+// usage: memory [main-binary...]; the peak RSS table runs ./main unless binaries are given
+
+const size_t SCRIPT_SIZES[] = { 1000000, 10000000, 100000000 };
+
+void parse_stats(const string& name, const string& code) {
+    Arena arena;
+    Parser parser(arena);
+    size_t heap_before = mallinfo2().uordblks;
+    parser.run(code);
+    size_t nodes = arena.objects_made();
+    size_t heap_growth = mallinfo2().uordblks - heap_before;
+    printf("  %-36s %10zu %12.1f %10.1f %12.1f\n", name.c_str(), nodes, arena.bytes_used() / 1e6,
+           static_cast<double>(arena.bytes_used()) / nodes, heap_growth / 1e6);
+}
+
+// Peak resident set of binary running script, in MB; -1 if it could not be started
+double peak_rss(const string& binary, const string& script) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execl(binary.c_str(), binary.c_str(), script.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0 || (WIFEXITED(status) && WEXITSTATUS(status) == 127)) { return -1; }
+    return usage.ru_maxrss / 1e3;
+}
+
+// Writes the generated scripts from a child process, so this one stays small: a forked child's peak RSS starts at
+// its parent's resident size
+vector<string> write_scripts() {
+    vector<string> paths;
+    for (size_t size : SCRIPT_SIZES) { paths.push_back("/tmp/hrl-memory-" + to_string(getpid()) + "-" + to_string(size / 1000000) + "mb.hr"); }
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (size_t i = 0; i < paths.size(); ++i) { ofstream(paths[i], ios::binary) << bench::generate_script(SCRIPT_SIZES[i]); }
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    return paths;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> binaries(argv + 1, argv + argc);
+    if (binaries.empty()) { binaries.push_back("./main"); }
+    vector<string> scripts = write_scripts();
+    printf("Peak RSS running generated scripts, MB\n");
+    printf("  %-36s", "binary");
+    for (size_t size : SCRIPT_SIZES) { printf(" %9zu MB", size / 1000000); }
+    printf("\n");
+    for (const string& binary : binaries) {
+        printf("  %-36s", binary.c_str());
+        for (const string& script : scripts) {
+            double rss = peak_rss(binary, script);
+            if (rss < 0) { printf(" %12s", "failed"); }
+            else { printf(" %12.1f", rss); }
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    for (const string& script : scripts) { filesystem::remove(script); }
+
+    printf("AST memory after parsing\n");
+    printf("  %-36s %10s %12s %10s %12s\n", "script", "nodes", "arena MB", "B/node", "heap MB");
+    vector<string> paths;
+    if (filesystem::is_directory("tests")) {
+        for (const auto& entry : filesystem::directory_iterator("tests")) {
+            if (entry.path().extension() == ".hr") { paths.push_back(entry.path().string()); }
+        }
+    }
+    sort(paths.begin(), paths.end());
+    for (const string& path : paths) {
+        stringstream contents;
+        contents << ifstream(path, ios::binary).rdbuf();
+        parse_stats(path, contents.str());
+    }
+    parse_stats("generated 1 MB", bench::generate_script(1000000));
+    parse_stats("generated 10 MB", bench::generate_script(10000000));
+    printf("  node sizes: BinOp %zu, Var %zu, IntVal %zu, Block %zu, FuncCall %zu bytes\n",
+           sizeof(BinOpNode), sizeof(VarNode), sizeof(IntValNode), sizeof(BlockNode), sizeof(FuncCallNode));
+    return 0;
+}
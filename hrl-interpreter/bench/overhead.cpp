@@ -0,0 +1,99 @@
+#include <cstdio>
+#include "Bench.h"
+#include "Engines.h"
+using namespace std;
+
+// Fork/join overhead on expression-heavy scripts: the tree-walker with the cost model's decisions against the same
+// tree with every binary operation marked parallel, which is how BinOpNode ran before the cost model
+
+const int RUNS = 3;
+
+// Marks every BinOpNode in the tree to evaluate its operands in an omp parallel sections region
+void fork_everywhere(NodePtr node) {
+    if (!node) { return; }
+    switch (node->kind) {
+        case NodeKind::BinOp: {
+            auto binop = static_cast<BinOpNode*>(node);
+            binop->parallel = true;
+            fork_everywhere(binop->left);
+            fork_everywhere(binop->right);
+            break;
+        }
+        case NodeKind::UnOp: fork_everywhere(static_cast<UnOpNode*>(node)->child); break;
+        case NodeKind::VarDeclare: fork_everywhere(static_cast<VarDeclareNode*>(node)->expression); break;
+        case NodeKind::Assignment: fork_everywhere(static_cast<AssignmentNode*>(node)->expression); break;
+        case NodeKind::While:
+            fork_everywhere(static_cast<WhileNode*>(node)->condition);
+            fork_everywhere(static_cast<WhileNode*>(node)->block);
+            break;
+        case NodeKind::If:
+            fork_everywhere(static_cast<IfNode*>(node)->condition);
+            fork_everywhere(static_cast<IfNode*>(node)->block);
+            fork_everywhere(static_cast<IfNode*>(node)->else_block);
+            break;
+        case NodeKind::FuncDeclare: fork_everywhere(static_cast<FuncDeclareNode*>(node)->block_node); break;
+        case NodeKind::FuncCall:
+            for (NodePtr arg : static_cast<FuncCallNode*>(node)->args) { fork_everywhere(arg); }
+            break;
+        case NodeKind::Return: fork_everywhere(static_cast<ReturnNode*>(node)->return_node); break;
+        case NodeKind::Block:
+            for (NodePtr statement : static_cast<BlockNode*>(node)->statements) { fork_everywhere(statement); }
+            break;
+        case NodeKind::Program:
+            fork_everywhere(static_cast<ProgramNode*>(node)->setup_block);
+            fork_everywhere(static_cast<ProgramNode*>(node)->main_block);
+            break;
+        default: break;
+    }
+}
+
+struct Workload {
+    const char* name;
+    const char* code;
+};
+
+const Workload WORKLOADS[] = {
+    { "6-operator expression, 300k",
+      "setup {\n"
+      "    i = 0;\n"
+      "    s = 0;\n"
+      "    while (i < 300000) {{\n"
+      "        s = (i * 3 + 7) % 11 - i / 5 + 2 * i;\n"
+      "        i = i + 1;\n"
+      "    }}\n"
+      "}\n"
+      "main {\n"
+      "}\n" },
+    { "modulo and add loop, 3M",
+      "setup {\n"
+      "    i = 0;\n"
+      "    s = 0;\n"
+      "    while (i < 3000000) {{\n"
+      "        s = s + i % 7;\n"
+      "        i = i + 1;\n"
+      "    }}\n"
+      "}\n"
+      "main {\n"
+      "}\n" },
+    { "calls in both operands, fib(22)",
+      "setup {\n"
+      "    function fib(n) {{\n"
+      "        if (n < 2) {{ return n; }}\n"
+      "        return fib(n - 1) + fib(n - 2);\n"
+      "    }}\n"
+      "    result = fib(22);\n"
+      "}\n"
+      "main {\n"
+      "}\n" },
+};
+
+int main() {
+    printf("Tree-walker fork overhead, ms (best of %d, OpenMP threads: %d)\n", RUNS, omp_get_max_threads());
+    printf("  %-34s %14s %14s %10s\n", "workload", "fork always", "cost model", "speedup");
+    for (const Workload& workload : WORKLOADS) {
+        double always = bench::best_setup(RUNS, bench::Engine::Tree, workload.code, fork_everywhere);
+        double model = bench::best_setup(RUNS, bench::Engine::Tree, workload.code);
+        printf("  %-34s %14.1f %14.1f %9.1fx\n", workload.name, always * 1e3, model * 1e3, always / model);
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Bench.h"
+#include "Parser.h"
+using namespace std;
+
+// Parses a batch of scripts with Parser::run_concurrently on 1, 2, 4, ... threads and reports the speedup over one
+// thread. Thread counts go up to the number of hardware threads, and at least to 4.
+
+const int RUNS = 3;
+const size_t SCRIPT_COUNT = 16;
+const size_t SCRIPT_SIZE = 1000000;
+
+int main() {
+    vector<string> scripts(SCRIPT_COUNT, bench::generate_script(SCRIPT_SIZE));
+    vector<string_view> sources(scripts.begin(), scripts.end());
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    printf("Parsing %zu scripts of %.0f MB concurrently (best of %d, hardware threads: %u)\n", SCRIPT_COUNT, SCRIPT_SIZE / 1e6, RUNS, hardware);
+    printf("  %8s %12s %12s %10s\n", "threads", "ms", "MB/s", "speedup");
+    double single = 0;
+    for (unsigned threads = 1; threads <= max(4u, hardware); threads *= 2) {
+        double seconds = bench::best_of(RUNS, [&] { Parser::run_concurrently(sources, threads); });
+        if (threads == 1) { single = seconds; }
+        printf("  %8u %12.1f %12.1f %9.2fx\n", threads, seconds * 1e3, SCRIPT_COUNT * SCRIPT_SIZE / seconds / 1e6, single / seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <cstdio>
+#include "Bench.h"
+#include "Engines.h"
+using namespace std;
+
+// Function call throughput: recursive fib and Ackermann on each engine, in calls per second. Call counts come from
+// the same recursions in C++.
+
+const int RUNS = 5;
+
+uint64_t fib_calls(int n) { return n < 2 ? 1 : 1 + fib_calls(n - 1) + fib_calls(n - 2); }
+
+uint64_t ack_calls(uint64_t m, uint64_t n, uint64_t& result) {
+    if (m == 0) {
+        result = n + 1;
+        return 1;
+    }
+    if (n == 0) { return 1 + ack_calls(m - 1, 1, result); }
+    uint64_t inner;
+    uint64_t calls = 1 + ack_calls(m, n - 1, inner);
+    return calls + ack_calls(m - 1, inner, result);
+}
+
+struct Workload {
+    const char* name;
+    const char* code;
+    uint64_t calls;
+};
+
+int main() {
+    uint64_t ack_result;
+    const Workload workloads[] = {
+        { "fib(27)",
+          "setup {\n"
+          "    function fib(n) {{\n"
+          "        if (n < 2) {{ return n; }}\n"
+          "        return fib(n - 1) + fib(n - 2);\n"
+          "    }}\n"
+          "    result = fib(27);\n"
+          "}\n"
+          "main {\n"
+          "}\n",
+          fib_calls(27) },
+        { "ack(2, 300)",
+          "setup {\n"
+          "    function ack(m, n) {{\n"
+          "        if (m == 0) {{ return n + 1; }}\n"
+          "        if (n == 0) {{ return ack(m - 1, 1); }}\n"
+          "        return ack(m - 1, ack(m, n - 1));\n"
+          "    }}\n"
+          "    result = ack(2, 300);\n"
+          "}\n"
+          "main {\n"
+          "}\n",
+          ack_calls(2, 300, ack_result) },
+    };
+    const bench::Engine engines[] = { bench::Engine::Tree, bench::Engine::Vm, bench::Engine::Tiered };
+    printf("Calls per second, millions (best of %d)\n", RUNS);
+    printf("  %-14s %10s", "workload", "calls");
+    for (bench::Engine engine : engines) { printf(" %10s", bench::engine_name(engine)); }
+    printf("\n");
+    for (const Workload& workload : workloads) {
+        printf("  %-14s %10llu", workload.name, static_cast<unsigned long long>(workload.calls));
+        for (bench::Engine engine : engines) {
+            double seconds = bench::best_setup(RUNS, engine, workload.code);
+            printf(" %10.2f", workload.calls / seconds / 1e6);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return 0;
+}
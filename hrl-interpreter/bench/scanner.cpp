@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "Tokenizer.h"
+using namespace std;
+
+// Lexes the same inputs with every scan kernel set this CPU supports (scalar, SSE2, AVX2) and checks that they
+// produce the same tokens. Each input is repeated to about 4 MB so the timings are stable.
+// usage: scanner [file.hr...]; without files it uses the examples and tests directories and two generated scripts
+
+const int RUNS = 5;
+const size_t INPUT_SIZE = 4000000;
+
+struct Input {
+    string name;
+    string code;
+};
+
+string repeated(const string& text) {
+    string code;
+    while (code.size() < INPUT_SIZE) { code += text + "\r\n"; }
+    return code;
+}
+
+string read_file(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file) { throw runtime_error("Unable to open file " + path); }
+    stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Deeply indented lines with long comments, identifiers and string literals: the long runs the kernels skip in blocks
+string long_runs_script() {
+    string line = string(24, ' ') + "-- " + string(100, 'c') + "\r\n" +
+                  string(24, ' ') + "sensor_reading_from_the_front_left_ultrasonic_unit = \"" + string(160, 's') + "\" .. 123456789;\r\n";
+    string code;
+    while (code.size() < INPUT_SIZE) { code += line; }
+    return code;
+}
+
+vector<const ScanKernels*> available_kernels() {
+    vector<const ScanKernels*> sets = { &scan::scalar_kernels };
+#ifdef HRL_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) { sets.push_back(&scan::sse2_kernels); }
+    if (__builtin_cpu_supports("avx2")) { sets.push_back(&scan::avx2_kernels); }
+#endif
+    return sets;
+}
+
+int main(int argc, char* argv[]) {
+    vector<Input> inputs;
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) { inputs.push_back({ argv[i], repeated(read_file(argv[i])) }); }
+    } else {
+        inputs.push_back({ "generated (short tokens)", bench::generate_script(INPUT_SIZE) });
+        inputs.push_back({ "generated (long runs)", long_runs_script() });
+        for (const char* directory : { "../examples", "tests" }) {
+            if (!filesystem::is_directory(directory)) { continue; }
+            vector<string> paths;
+            for (const auto& entry : filesystem::directory_iterator(directory)) {
+                if (entry.path().extension() == ".hr") { paths.push_back(entry.path().string()); }
+            }
+            sort(paths.begin(), paths.end());
+            for (const string& path : paths) { inputs.push_back({ path, repeated(read_file(path)) }); }
+        }
+    }
+
+    vector<const ScanKernels*> sets = available_kernels();
+    printf("Lexing with each scan kernel set, Mtok/s (best of %d, inputs repeated to %.0f MB)\n", RUNS, INPUT_SIZE / 1e6);
+    printf("  %-40s", "input");
+    for (const ScanKernels* set : sets) { printf(" %10s", set->name); }
+    printf("\n");
+    for (const Input& input : inputs) {
+        printf("  %-40s", input.name.c_str());
+        TokenBuffer reference;
+        Tokenizer(input.code, scan::scalar_kernels).tokenize(reference);
+        for (const ScanKernels* set : sets) {
+            TokenBuffer tokens;
+            double seconds = bench::best_of(RUNS, [&] {
+                tokens = TokenBuffer();
+                Tokenizer(input.code, *set).tokenize(tokens);
+            });
+            if (tokens.kinds != reference.kinds || tokens.offsets != reference.offsets || tokens.lengths != reference.lengths) {
+                printf("\n  %s produced different tokens than scalar\n", set->name);
+                return 1;
+            }
+            printf(" %10.1f", tokens.size() / seconds / 1e6);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "Bench.h"
+#include "SourceFile.h"
+#include "Parser.h"
+using namespace std;
+
+// Startup latency on generated 1 MB, 10 MB and 100 MB scripts: loading the file the way main.cpp used to (getline
+// and string +=) against SourceFile, and the whole way to a parsed tree, which is when the first statement runs.
+// Files are written just before they are read, so they come from the page cache.
+
+const int RUNS = 3;
+
+string load_with_getline(const string& path) {
+    ifstream file(path);
+    string code, line;
+    while (getline(file, line)) { code += line + '\n'; }
+    return code;
+}
+
+// Counts lines, so every byte of a mapped file is really read before the clock stops, as the lexer would
+size_t touch(string_view code) { return count(code.begin(), code.end(), '\n'); }
+
+int main() {
+    printf("Startup latency, ms (best of %d)\n", RUNS);
+    printf("  %-10s %12s %12s %14s\n", "script", "getline", "SourceFile", "load + parse");
+    for (size_t megabytes : { 1, 10, 100 }) {
+        char path[] = "/tmp/hrl-startup-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            perror("mkstemp");
+            return 1;
+        }
+        string script = bench::generate_script(megabytes * 1000000);
+        if (write(fd, script.data(), script.size()) != static_cast<ssize_t>(script.size())) {
+            perror("write");
+            return 1;
+        }
+        close(fd);
+        script.clear();
+        script.shrink_to_fit();
+
+        size_t sink = 0;
+        double getline_seconds = bench::best_of(RUNS, [&] { sink += touch(load_with_getline(path)); });
+        double mapped_seconds = bench::best_of(RUNS, [&] {
+            SourceFile source;
+            source.open(path);
+            sink += touch(source.view());
+        });
+        double parse_seconds = bench::best_of(RUNS, [&] {
+            SourceFile source;
+            source.open(path);
+            Arena arena;
+            Parser parser(arena);
+            sink += parser.run(source.view()) != nullptr;
+        });
+        unlink(path);
+        printf("  %4zu MB    %12.1f %12.1f %14.1f\n", megabytes, getline_seconds * 1e3, mapped_seconds * 1e3, parse_seconds * 1e3);
+        if (sink == 0) { printf("  (nothing was read)\n"); }
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <omp.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "SourceFile.h"
+#include "Parser.h"
+#include "Transpiler.h"
+using namespace std;
+
+SourceFile source;
+Arena ast_arena;
+Parser parser(ast_arena);
+
+int main(int argc, char *argv[]) {
+    // hrlc <input.hr | -> [-o output.cpp]; the generated C++ goes to stdout unless -o is given
+    string filename;
+    string output;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) { output = argv[++i]; }
+        else if (filename.empty()) { filename = arg; }
+        else { filename.clear(); break; }
+    }
+    if (filename.empty()) {
+        cout << "Usage: " << argv[0] << " <input.hr | -> [-o output.cpp]" << endl;
+        return 1;
+    }
+    if (!source.open(filename)) {
+        cout << "Error: Unable to open file " << filename << endl;
+        return 1;
+    }
+
+    omp_set_num_threads(omp_get_max_threads());
+    NodePtr root = parser.run(source.view());
+    string code = Transpiler(filename == "-" ? "stdin" : filename).run(root);
+
+    if (output.empty()) { cout << code; }
+    else {
+        ofstream file(output);
+        if (!file) {
+            cout << "Error: Unable to write file " << output << endl;
+            return 1;
+        }
+        file << code;
+    }
+    return 0;
+}
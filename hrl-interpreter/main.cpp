@@ -1,46 +1,123 @@
 #include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
 #include <iostream>
-#include <fstream>
+#include <memory>
 #include <string>
-#include "Preprocessor.h"
+#include <thread>
+#include "SourceFile.h"
 #include "Parser.h"
+#include "Tiering.h"
+#include "VM.h"
 using namespace std;
 
-Tokenizer Parser::tokenizer = Tokenizer("");
-Token Parser::current_token;
-Parser parser;
+// Calls or loop iterations the tiered engine interprets before compiling a function or loop to bytecode
+const uint32_t DEFAULT_TIER_THRESHOLD = 1000;
+
+SourceFile source;
+Arena ast_arena;
+Parser parser(ast_arena);
 SymbolTable table;
 FuncTable func_table;
+unique_ptr<BytecodeTier> tier;
+unique_ptr<NativeJit> jit;
+bool show_stats = false;
+terminate_handler previous_terminate;
+int signal_pipe[2];
+
+// Scripts run until they fail or are interrupted, so --stats is printed on every way out of the process
+void print_stats() {
+    static atomic<bool> printed{ false };
+    if (tier && show_stats && !printed.exchange(true)) { tier->print_stats(cerr); }
+}
+
+// Run on every way out of the process, where destructors are skipped
+void finish() {
+    print_stats();
+    if (jit) { jit->shut_down(); }
+}
+
+// finish locks and writes to iostreams, which a signal handler must not do, so the handler only passes the signal
+// on through a pipe and this thread calls it before the signal takes its default action
+void finish_on_signal() {
+    unsigned char signal_number;
+    while (read(signal_pipe[0], &signal_number, 1) != 1) {
+        if (errno != EINTR) { return; }
+    }
+    finish();
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+void forward_signal(int signal_number) {
+    unsigned char number = signal_number;
+    if (write(signal_pipe[1], &number, 1) != 1) { _exit(128 + signal_number); }
+}
 
 int main(int argc, char *argv[]) {
     // Read HRL code from file
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " <input.hr>" << endl;
+    string filename;
+    string engine = "tiered";
+    uint32_t threshold = DEFAULT_TIER_THRESHOLD;
+    bool use_jit = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) { engine = arg.substr(9); }
+        else if (arg == "--stats") { show_stats = true; }
+        else if (arg == "--jit") { use_jit = true; }
+        else if (arg.rfind("--tier-threshold=", 0) == 0) { threshold = strtoul(arg.c_str() + 17, nullptr, 10); }
+        else if (filename.empty()) { filename = arg; }
+        else { filename.clear(); break; }
+    }
+    if (filename.empty() || (engine != "tree" && engine != "vm" && engine != "tiered") || threshold == 0 || (use_jit && engine != "tiered")) {
+        cout << "Usage: " << argv[0] << " [options] <input.hr | ->" << endl
+             << "  --engine=tiered     walk the AST and compile hot functions and loops to bytecode (default)" << endl
+             << "  --engine=tree       only walk the AST" << endl
+             << "  --engine=vm         compile every block and function to bytecode the first time it runs" << endl
+             << "  --tier-threshold=N  calls or loop iterations before the tiered engine compiles (default " << DEFAULT_TIER_THRESHOLD << ")" << endl
+             << "  --jit               also build hot functions that only use ints and bools into native code (tiered only)" << endl
+             << "  --stats             print what the tiered engine compiled when the script ends" << endl;
         return 1;
     }
-    string filename = argv[1];
-    ifstream file(filename);
-    if (!file.is_open()) {
+    if (!source.open(filename)) {
         cout << "Error: Unable to open file " << filename << endl;
         return 1;
     }
-    string code;
-    string line;
-    while (getline(file, line)) { code += line + '\n'; }
-    file.close();
-
-    // Preprocess
-    string filtered_code = PrePro::preprocess(code);
-
-    // Tokenize
-    parser.tokenizer = Tokenizer(filtered_code);
+    string_view code = source.view();
 
-    // Parse
+    // Tokenize the whole file up front (comments and blank lines are skipped while scanning), then parse
     omp_set_num_threads(omp_get_max_threads());
-    shared_ptr<Node> root = parser.run(filtered_code);
+    NodePtr root = parser.run(code);
 
-    // Interpret
-    root->Evaluate(table, func_table);
+    // The tiered engine walks the AST and moves hot functions and loops to bytecode; the others stay in one tier
+    if (engine == "tiered") {
+        tier = make_unique<BytecodeTier>(func_table, code, threshold);
+        func_table.tiering = tier.get();
+        // Hot functions that only compute with ints are also built into native code, in the background
+        if (use_jit) {
+            jit = make_unique<NativeJit>(func_table);
+            tier->jit = jit.get();
+        }
+        atexit(finish);
+        previous_terminate = set_terminate([] {
+            finish();
+            previous_terminate();
+        });
+        if ((show_stats || jit) && pipe2(signal_pipe, O_CLOEXEC) == 0) {
+            thread(finish_on_signal).detach();
+            signal(SIGINT, forward_signal);
+            signal(SIGTERM, forward_signal);
+        }
+    }
+    if (engine == "vm") {
+        VM vm(func_table);
+        vm.run(root, table);
+    }
+    else { root->Evaluate(table, func_table); }
 
     return 0;
 }
\ No newline at end of file
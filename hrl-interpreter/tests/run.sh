@@ -0,0 +1,59 @@
+#!/bin/bash
+# Runs every tests/*.hr with each interpreter engine and as a program built by hrlc, and checks that all of them
+# print exactly tests/<name>.out. HRL has no exit statement, so a test ends by calling the undefined function stop()
+# (or by another runtime error), which every engine reports the same way. Prints the run time of each engine.
+#
+# usage: tests/run.sh [test.hr...]    (from hrl-interpreter, after make; `make test` does both)
+cd "$(dirname "$0")/.." || exit 1
+CXX=${CXX:-g++}
+TIMEOUT=${TIMEOUT:-60}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+# Native code built by --jit goes to a cache of its own, so every run starts cold
+export HRL_JIT_CACHE=$work/jit
+
+engines=(tree vm tiered jit hrlc)
+declare -A flags=([tree]="--engine=tree" [vm]="--engine=vm" [tiered]="--engine=tiered" [jit]="--engine=tiered --jit")
+
+tests=("$@")
+[ ${#tests[@]} -eq 0 ] && tests=(tests/*.hr)
+
+# Output (stdout and stderr) of one run in $output, its wall time in seconds in $elapsed
+run() {
+    local start=$EPOCHREALTIME
+    output=$(timeout "$TIMEOUT" "$@" 2>&1)
+    elapsed=$(awk "BEGIN { print $EPOCHREALTIME - $start }")
+}
+
+failed=0
+printf "%-20s" "test"
+for engine in "${engines[@]}"; do printf "%10s" "$engine"; done
+echo
+for test in "${tests[@]}"; do
+    name=$(basename "$test" .hr)
+    expected="${test%.hr}.out"
+    printf "%-20s" "$name"
+    failures=()
+    for engine in "${engines[@]}"; do
+        if [ "$engine" = hrlc ]; then
+            if ! ./hrlc "$test" -o "$work/$name.cpp" > "$work/$name.log" 2>&1 \
+                || ! $CXX -O3 -std=c++20 -I. "$work/$name.cpp" -o "$work/$name" -lpthread >> "$work/$name.log" 2>&1; then
+                printf "%10s" "build"
+                failures+=("hrlc: $(head -3 "$work/$name.log")")
+                continue
+            fi
+            run "$work/$name"
+        else
+            run ./main ${flags[$engine]} "$test"
+        fi
+        printf "%9.3fs" "$elapsed"
+        if [ "$output" != "$(cat "$expected")" ]; then
+            failures+=("$engine: $(diff <(echo "$output") "$expected" | head -6)")
+        fi
+    done
+    echo
+    for failure in "${failures[@]}"; do echo "  FAIL $failure"; done
+    [ ${#failures[@]} -ne 0 ] && failed=1
+done
+[ $failed -eq 0 ] && echo "All tests passed"
+exit $failed